@@ -0,0 +1,259 @@
+//============================================================================
+// Name        : Benchmark.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : non-interactive throughput benchmark of all processing routines
+//============================================================================
+
+#include "Benchmark.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/resource.h>
+
+// smoothing types of Dip3::mySmooth and their names
+static const int SMOOTH_TYPES[] = {0, 1, 2, 3, 4, 6};
+static const char* SMOOTH_NAMES[] = {"spatial", "frequency", "separable", "sat", "auto", "recursive"};
+static const int NUM_SMOOTH_TYPES = sizeof(SMOOTH_TYPES) / sizeof(SMOOTH_TYPES[0]);
+
+// kernel sizes and nlm search window sizes of the sweep
+static const int KERNEL_SIZES[] = {3, 5, 9, 15, 31};
+static const int NUM_KERNEL_SIZES = sizeof(KERNEL_SIZES) / sizeof(KERNEL_SIZES[0]);
+static const int SEARCH_SIZES[] = {5, 11, 21};
+static const int NUM_SEARCH_SIZES = sizeof(SEARCH_SIZES) / sizeof(SEARCH_SIZES[0]);
+
+// a case is repeated until it ran at least this long (but at most MAX_REPS times)
+static const double MIN_SECONDS = 0.25;
+static const int MAX_REPS = 50;
+
+// constructor
+/*
+maxSize  :  largest image side, sizes are 256, 512, ... maxSize
+budget   :  cases whose single call is expected to take longer (extrapolated from the
+            previous size) are skipped
+*/
+Benchmark::Benchmark(int maxSize, double budget) : budget(budget){
+
+   for(int s = 256; s <= maxSize; s *= 2)
+      sizes.push_back(s);
+
+}
+
+// random image with integral grey values, so that the quantized code paths are taken as well
+/*
+size     :  width and height of the image
+return   :  CV_32FC1 image
+*/
+Mat Benchmark::makeImage(int size){
+
+   Mat img(size, size, CV_32FC1);
+   RNG rng(size);
+   for(int y = 0; y < size; y++){
+      float* row = img.ptr<float>(y);
+      for(int x = 0; x < size; x++)
+         row[x] = (float)(rng() % 256);
+   }
+   return img;
+
+}
+
+// normalized gaussian kernel, standard deviation as used by Dip3::usm
+/*
+kSize    :  kernel size
+return   :  kSize x kSize CV_32FC1 kernel
+*/
+Mat Benchmark::makeGaussian(int kSize){
+
+   Mat g = getGaussianKernel(kSize, kSize / 5., CV_32F);
+   Mat kernel = g * g.t();
+   return kernel / sum(kernel).val[0];
+
+}
+
+// peak resident set size in kB
+long Benchmark::peakRss(void){
+
+#ifdef __linux__
+   // VmHWM can be reset, ru_maxrss can not
+   ifstream status("/proc/self/status");
+   string line;
+   while(getline(status, line)){
+      if (line.compare(0, 6, "VmHWM:") == 0)
+         return atol(line.c_str() + 6);
+   }
+#endif
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+   return usage.ru_maxrss / 1024;
+#else
+   return usage.ru_maxrss;
+#endif
+
+}
+
+// resets the peak RSS to the current RSS (linux only), elsewhere the peak of the whole process is reported
+long Benchmark::resetPeakRss(void){
+
+#ifdef __linux__
+   ofstream clear("/proc/self/clear_refs");
+   if (clear)
+      clear << "5" << endl;
+#endif
+   return peakRss();
+
+}
+
+// times one routine on one image size
+/*
+kernel   :  name of the routine
+params   :  parameters of the case
+size     :  image size
+body     :  calls the routine on the given image (the image is a fresh copy and may be changed)
+*/
+void Benchmark::measure(const string& kernel, const string& params, int size, const function<void(Mat&)>& body){
+
+   string key = kernel + " " + params;
+   double pixels = (double)size * size;
+
+   // skip the case if the previous size already was too slow
+   map<string, double>::iterator last = lastNsPerPixel.find(key);
+   if (last != lastNsPerPixel.end() && last->second * pixels * 1e-9 > budget){
+      cerr << "skipping " << key << " at " << size << "x" << size << " (expected "
+           << last->second * pixels * 1e-9 << " s per call)" << endl;
+      return;
+   }
+
+   Mat img = makeImage(size);
+   resetPeakRss();
+
+   double total = 0;
+   int reps = 0;
+   while (reps < MAX_REPS && (reps == 0 || total < MIN_SECONDS)){
+      Mat work = img.clone();
+      int64 start = getTickCount();
+      body(work);
+      total += (getTickCount() - start) / getTickFrequency();
+      reps++;
+      // a single call beyond the budget is enough
+      if (total > budget)
+         break;
+   }
+
+   BenchResult res;
+   res.kernel = kernel;
+   res.params = params;
+   res.size = size;
+   res.reps = reps;
+   res.seconds = total / reps;
+   res.mpixPerSec = pixels / res.seconds * 1e-6;
+   res.nsPerPixel = res.seconds / pixels * 1e9;
+   res.peakRssKB = peakRss();
+   results.push_back(res);
+
+   lastNsPerPixel[key] = res.nsPerPixel;
+
+   cerr << kernel << " " << params << " " << size << "x" << size << ": "
+        << res.mpixPerSec << " Mpix/s" << endl;
+
+}
+
+// times every routine for all sizes
+void Benchmark::run(void){
+
+   for(size_t s = 0; s < sizes.size(); s++){
+      int size = sizes[s];
+
+      // Dip1
+      measure("Dip1::doSomethingThatMyTutorIsGonnaLike", "-", size, [&](Mat& img){
+         dip1.doSomethingThatMyTutorIsGonnaLike(img);
+      });
+
+      // Dip2 and Dip3, kernel size sweep
+      for(int k = 0; k < NUM_KERNEL_SIZES; k++){
+         int kSize = KERNEL_SIZES[k];
+         ostringstream param;
+         param << "k=" << kSize;
+
+         Mat box = Mat::ones(kSize, kSize, CV_32FC1) / (kSize * kSize);
+         measure("Dip2::spatialConvolution", param.str(), size, [&](Mat& img){
+            dip2.spatialConvolution(img, box);
+         });
+         measure("Dip2::averageFilter", param.str(), size, [&](Mat& img){
+            dip2.averageFilter(img, kSize);
+         });
+         measure("Dip2::medianFilter", param.str(), size, [&](Mat& img){
+            dip2.medianFilter(img, kSize);
+         });
+         measure("Dip2::bilateralFilter", param.str(), size, [&](Mat& img){
+            dip2.bilateralFilter(img, kSize, 20);
+         });
+
+         for(int t = 0; t < NUM_SMOOTH_TYPES; t++){
+            int type = SMOOTH_TYPES[t];
+            measure(string("Dip3::mySmooth/") + SMOOTH_NAMES[t], param.str(), size, [&](Mat& img){
+               dip3.mySmooth(img, kSize, type);
+            });
+         }
+         // unsharp masking by separate passes and fused into one pass
+         measure("Dip3::usm/separable", param.str(), size, [&](Mat& img){
+            dip3.usm(img, 2, kSize, 5, 1.5);
+         });
+         measure("Dip3::usm/fused", param.str(), size, [&](Mat& img){
+            dip3.usm(img, 5, kSize, 5, 1.5);
+         });
+
+         Mat gauss = makeGaussian(kSize);
+         measure("Dip4::inverseFilter", param.str(), size, [&](Mat& img){
+            dip4.inverseFilter(img, gauss);
+         });
+         measure("Dip4::wienerFilter", param.str(), size, [&](Mat& img){
+            dip4.wienerFilter(img, gauss, 100);
+         });
+      }
+
+      // Dip2, nlm search size sweep
+      for(int k = 0; k < NUM_SEARCH_SIZES; k++){
+         int searchSize = SEARCH_SIZES[k];
+         ostringstream param;
+         param << "search=" << searchSize;
+         measure("Dip2::nlmFilter", param.str(), size, [&](Mat& img){
+            dip2.nlmFilter(img, searchSize, 20);
+         });
+      }
+   }
+
+}
+
+// writes the results
+/*
+out      :  output stream
+json     :  JSON array of objects if true, CSV with header line otherwise
+*/
+void Benchmark::write(ostream& out, bool json){
+
+   out << setprecision(6);
+   if (json){
+      out << "[" << endl;
+      for(size_t i = 0; i < results.size(); i++){
+         const BenchResult& r = results[i];
+         out << "  {\"kernel\": \"" << r.kernel << "\", \"params\": \"" << r.params
+             << "\", \"size\": " << r.size << ", \"reps\": " << r.reps
+             << ", \"seconds\": " << r.seconds << ", \"mpix_per_s\": " << r.mpixPerSec
+             << ", \"ns_per_pixel\": " << r.nsPerPixel << ", \"peak_rss_kb\": " << r.peakRssKB
+             << "}" << (i + 1 < results.size() ? "," : "") << endl;
+      }
+      out << "]" << endl;
+   }else{
+      out << "kernel,params,size,reps,seconds,mpix_per_s,ns_per_pixel,peak_rss_kb" << endl;
+      for(size_t i = 0; i < results.size(); i++){
+         const BenchResult& r = results[i];
+         out << r.kernel << "," << r.params << "," << r.size << "," << r.reps << ","
+             << r.seconds << "," << r.mpixPerSec << "," << r.nsPerPixel << "," << r.peakRssKB << endl;
+      }
+   }
+
+}
@@ -0,0 +1,81 @@
+//============================================================================
+// Name        : Benchmark.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : non-interactive throughput benchmark of all processing routines
+//============================================================================
+
+#ifndef BENCHMARK_BENCHMARK_H
+#define BENCHMARK_BENCHMARK_H
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "../Filters/Dip2.h"
+#include "../Convolution & Gaussian Kernel/Dip3.h"
+#include "../Inverse vs Wiener/Dip4.h"
+// Dip1.h defines max/min as macros, so it has to come last
+#include "../pre-processing/Dip1.h"
+#undef max
+#undef min
+
+using namespace std;
+using namespace cv;
+
+// one measured case
+struct BenchResult{
+   string kernel;       // name of the timed routine
+   string params;       // kernel/search size and similar, "k=5"
+   int size;            // image is size x size pixels
+   int reps;            // number of timed calls
+   double seconds;      // mean time of one call
+   double mpixPerSec;   // throughput in megapixel per second
+   double nsPerPixel;   // time per pixel in nanoseconds
+   long peakRssKB;      // peak resident set size while running the case
+};
+
+class Benchmark{
+
+   public:
+      // constructor
+      // maxSize: largest image side, budget: time in seconds a single call may take
+      Benchmark(int maxSize = 8192, double budget = 5.0);
+      // destructor
+      ~Benchmark(void){};
+
+      // times every routine for all image sizes and kernel/search sizes
+      void run(void);
+      // writes all results as CSV or as JSON
+      void write(ostream& out, bool json);
+
+   private:
+      // times body on copies of a size x size image, stores the result
+      void measure(const string& kernel, const string& params, int size, const function<void(Mat&)>& body);
+      // random image with integral grey values in [0,255]
+      Mat makeImage(int size);
+      // normalized gaussian kernel of given size
+      Mat makeGaussian(int kSize);
+      // resets the peak RSS if the system allows it and returns the current peak in kB
+      long resetPeakRss(void);
+      long peakRss(void);
+
+      // image sizes (powers of two from 256 up to maxSize)
+      vector<int> sizes;
+      double budget;
+      // ns per pixel of the last run of every case, used to skip cases that would exceed the budget
+      map<string, double> lastNsPerPixel;
+      vector<BenchResult> results;
+
+      Dip1 dip1;
+      Dip2 dip2;
+      Dip3 dip3;
+      Dip4 dip4;
+};
+
+#endif
@@ -0,0 +1,70 @@
+//============================================================================
+// Name        : main.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : runs the throughput benchmark, nothing waits for user input
+//============================================================================
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Benchmark.h"
+#include "../Common/ThreadPool.h"
+
+using namespace std;
+
+// build (from the repository root, see CMakeLists.txt):
+//    cmake -S . -B build && cmake --build build --target benchmark
+// usage: benchmark [--csv | --json] [--max-size n] [--threads n] [--budget seconds] [--out file]
+//    --csv / --json   output format (default csv)
+//    --max-size       largest image side, sizes are 256, 512, ..., n (default 8192)
+//    --threads        number of threads (default all cores or DIP_NUM_THREADS)
+//    --budget         skip a case if a single call is expected to take longer (default 5 seconds)
+//    --out            write the results into a file instead of stdout
+// progress is reported on stderr
+int main(int argc, char** argv) {
+
+   bool json = false;
+   int maxSize = 8192;
+   double budget = 5;
+   string outFile;
+
+   for(int i = 1; i < argc; i++){
+      if (strcmp(argv[i], "--csv") == 0){
+         json = false;
+      }else if (strcmp(argv[i], "--json") == 0){
+         json = true;
+      }else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc){
+         maxSize = atoi(argv[++i]);
+      }else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc){
+         ThreadPool::instance().setNumThreads(atoi(argv[++i]));
+      }else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc){
+         budget = atof(argv[++i]);
+      }else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc){
+         outFile = argv[++i];
+      }else{
+         cerr << "Usage:\n\tbenchmark [--csv | --json] [--max-size n] [--threads n] [--budget seconds] [--out file]" << endl;
+         return -1;
+      }
+   }
+
+   Benchmark bench(maxSize, budget);
+   bench.run();
+
+   if (outFile.empty()){
+      bench.write(cout, json);
+   }else{
+      ofstream out(outFile.c_str());
+      if (!out){
+         cerr << "ERROR: Cannot open " << outFile << endl;
+         return -2;
+      }
+      bench.write(out, json);
+   }
+
+   return 0;
+
+}
@@ -0,0 +1,91 @@
+//============================================================================
+// Name        : BoundedQueue.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : blocking queue of limited capacity connecting pipeline stages
+//============================================================================
+
+#ifndef COMMON_BOUNDEDQUEUE_H
+#define COMMON_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+// producers block while the queue is full, so a fast stage cannot run ahead of a slow one by more
+// than the capacity; consumers block while it is empty. After close() the remaining items can
+// still be popped, then pop() returns false
+template<class T>
+class BoundedQueue{
+
+   public:
+      // constructor, capacity >= 1
+      BoundedQueue(size_t capacity) : capacity(capacity < 1 ? 1 : capacity), closed(false){};
+      // destructor
+      ~BoundedQueue(void){};
+
+      // appends item, waits while the queue is full; false if the queue is closed
+      bool push(const T& item){
+         unique_lock<mutex> guard(lock);
+         notFull.wait(guard, [&](){ return items.size() < capacity || closed; });
+         if (closed){
+            return false;
+         }
+         items.push_back(item);
+         notEmpty.notify_one();
+         return true;
+      };
+      // appends item if there is space, never waits
+      bool tryPush(const T& item){
+         lock_guard<mutex> guard(lock);
+         if (closed || items.size() >= capacity){
+            return false;
+         }
+         items.push_back(item);
+         notEmpty.notify_one();
+         return true;
+      };
+      // removes the oldest item, waits while the queue is empty; false if it is closed and empty
+      bool pop(T& item){
+         unique_lock<mutex> guard(lock);
+         notEmpty.wait(guard, [&](){ return !items.empty() || closed; });
+         if (items.empty()){
+            return false;
+         }
+         item = items.front();
+         items.pop_front();
+         notFull.notify_one();
+         return true;
+      };
+      // removes the oldest item if there is one, never waits
+      bool tryPop(T& item){
+         lock_guard<mutex> guard(lock);
+         if (items.empty()){
+            return false;
+         }
+         item = items.front();
+         items.pop_front();
+         notFull.notify_one();
+         return true;
+      };
+      // no more pushes, wakes up all waiting threads
+      void close(void){
+         lock_guard<mutex> guard(lock);
+         closed = true;
+         notFull.notify_all();
+         notEmpty.notify_all();
+      };
+
+   private:
+      mutex lock;
+      condition_variable notFull;
+      condition_variable notEmpty;
+      deque<T> items;
+      size_t capacity;
+      bool closed;
+};
+
+#endif
@@ -0,0 +1,455 @@
+//============================================================================
+// Name        : ConvEngine.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : 
+//============================================================================
+
+#include "ConvEngine.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// input footprint of one tile in bytes, about half of a typical L2 cache
+static const int TILE_BYTES = 128 * 1024;
+// width of one tile in pixels
+static const int TILE_COLS = 256;
+// tile size of the separable convolution, only one line buffer per tile is needed
+static const int SEP_TILE_COLS = 1024;
+static const int SEP_TILE_ROWS = 64;
+
+// vertical 1D pass of the separable convolution for columns begin..end-1 of one output row
+// rows[k] points to the input row of tap k, neighbouring columns are processed together
+// in SIMD registers (contiguous loads, no transpose needed)
+/*
+rows:    input rows of the n taps
+w:       flipped 1D kernel
+n:       kernel size
+begin:   first column
+end:     one past the last column
+out:     out[0] receives column begin
+*/
+static void verticalPass(const float* const* rows, const float* w, int n, int begin, int end, float* out){
+
+   int j = begin;
+
+#if defined(__AVX2__)
+   for (; j + 8 <= end; j += 8){
+      __m256 res = _mm256_setzero_ps();
+      for (int k = 0; k < n; k++){
+         res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + j), _mm256_set1_ps(w[k])));
+      }
+      _mm256_storeu_ps(out + j - begin, res);
+   }
+#endif
+#if defined(__SSE2__)
+   for (; j + 4 <= end; j += 4){
+      __m128 res = _mm_setzero_ps();
+      for (int k = 0; k < n; k++){
+         res = _mm_add_ps(res, _mm_mul_ps(_mm_loadu_ps(rows[k] + j), _mm_set1_ps(w[k])));
+      }
+      _mm_storeu_ps(out + j - begin, res);
+   }
+#endif
+
+   for (; j < end; j++){
+      float res = 0;
+      for (int k = 0; k < n; k++){
+         res = res + rows[k][j] * w[k];
+      }
+      out[j - begin] = res;
+   }
+}
+
+// horizontal 1D pass of the separable convolution along a padded line
+/*
+line:    vertical pass result, output pixel j uses line[j] .. line[j+n-1]
+w:       flipped 1D kernel
+n:       kernel size
+width:   number of output pixels
+out:     output pixels
+*/
+static void horizontalPass(const float* line, const float* w, int n, int width, float* out){
+
+   int j = 0;
+
+#if defined(__AVX2__)
+   for (; j + 8 <= width; j += 8){
+      __m256 res = _mm256_setzero_ps();
+      for (int l = 0; l < n; l++){
+         res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_loadu_ps(line + j + l), _mm256_set1_ps(w[l])));
+      }
+      _mm256_storeu_ps(out + j, res);
+   }
+#endif
+#if defined(__SSE2__)
+   for (; j + 4 <= width; j += 4){
+      __m128 res = _mm_setzero_ps();
+      for (int l = 0; l < n; l++){
+         res = _mm_add_ps(res, _mm_mul_ps(_mm_loadu_ps(line + j + l), _mm_set1_ps(w[l])));
+      }
+      _mm_storeu_ps(out + j, res);
+   }
+#endif
+
+   for (; j < width; j++){
+      float res = 0;
+      for (int l = 0; l < n; l++){
+         res = res + line[j + l] * w[l];
+      }
+      out[j] = res;
+   }
+}
+
+// convolution in spatial domain
+/*
+src:     input image (CV_32FC1)
+kernel:  filter kernel (square, CV_32FC1)
+return:  convolution result
+*/
+Mat ConvEngine::convolve(Mat& src, Mat& kernel){
+
+   int kSize = kernel.rows;
+   Mat output = Mat::zeros(src.rows, src.cols, CV_32FC1);
+
+   // flip the kernel (kept as a plain array, the inner loops broadcast from it)
+   vector<float> kernel_flip(kSize*kSize);
+   for (int k = 0; k < kSize; k++){
+      for (int l = 0; l < kSize; l++){
+         kernel_flip[k*kSize + l] = kernel.at<float>(kSize - 1 - k, kSize - 1 - l);
+      }
+   }
+
+   // tiles are sized such that their input footprint stays in cache
+   int tileCols = min(src.cols, TILE_COLS);
+   int tileRows = TILE_BYTES / (sizeof(float) * (tileCols + kSize - 1)) - (kSize - 1);
+   tileRows = max(8, min(src.rows, tileRows));
+
+   int tilesX = (src.cols + tileCols - 1) / tileCols;
+   int tilesY = (src.rows + tileRows - 1) / tileRows;
+
+   // each tile writes its own part of the output only --> result does not depend on the thread count
+   pool.parallelFor(tilesX * tilesY, [&](int t){
+      int x = (t % tilesX) * tileCols;
+      int y = (t / tilesX) * tileRows;
+      Rect tile(x, y, min(tileCols, src.cols - x), min(tileRows, src.rows - y));
+      convolveTile(src, output, &kernel_flip[0], kSize, tile);
+   });
+
+   return output;
+}
+
+// sharpening step of the unsharp masking for one row, d = in - smooth is kept where d > thresh
+/*
+in:      input pixels
+smooth:  smoothed input pixels
+thresh:  minimal difference
+scale:   scaling of the difference
+width:   number of pixels
+out:     in + scale * thresholded d
+*/
+static void sharpenRow(const float* in, const float* smooth, float thresh, float scale, int width, float* out){
+
+   int j = 0;
+
+#if defined(__AVX2__)
+   __m256 t8 = _mm256_set1_ps(thresh);
+   __m256 s8 = _mm256_set1_ps(scale);
+   for (; j + 8 <= width; j += 8){
+      __m256 x = _mm256_loadu_ps(in + j);
+      __m256 d = _mm256_sub_ps(x, _mm256_loadu_ps(smooth + j));
+      d = _mm256_and_ps(d, _mm256_cmp_ps(d, t8, _CMP_GT_OQ));
+      _mm256_storeu_ps(out + j, _mm256_add_ps(x, _mm256_mul_ps(s8, d)));
+   }
+#endif
+#if defined(__SSE2__)
+   __m128 t4 = _mm_set1_ps(thresh);
+   __m128 s4 = _mm_set1_ps(scale);
+   for (; j + 4 <= width; j += 4){
+      __m128 x = _mm_loadu_ps(in + j);
+      __m128 d = _mm_sub_ps(x, _mm_loadu_ps(smooth + j));
+      d = _mm_and_ps(d, _mm_cmpgt_ps(d, t4));
+      _mm_storeu_ps(out + j, _mm_add_ps(x, _mm_mul_ps(s4, d)));
+   }
+#endif
+
+   for (; j < width; j++){
+      float d = in[j] - smooth[j];
+      out[j] = in[j] + scale * ((d > thresh) ? d : 0.f);
+   }
+}
+
+// convolution in spatial domain with a separable kernel
+// a vertical pass along the image rows followed by a horizontal pass along a line buffer,
+// the result equals convolve() with the kernel colKernel * rowKernel (up to rounding)
+/*
+src:        input image (CV_32FC1)
+rowKernel:  horizontal 1D kernel (CV_32FC1, 1 x n or n x 1)
+colKernel:  vertical 1D kernel (CV_32FC1, 1 x m or m x 1)
+return:     convolution result
+*/
+Mat ConvEngine::convolveSeparable(Mat& src, Mat& rowKernel, Mat& colKernel){
+
+   return separable(src, rowKernel, colKernel, false, 0, 0);
+}
+
+// unsharp masking in a single pass over the image
+// every row is smoothed into a line buffer and sharpened right away, so the image is read once and
+// the result written once; the separate smooth, subtract, threshold and add passes need four
+// image sized temporaries and about five times the memory traffic
+/*
+src:        input image (CV_32FC1)
+rowKernel:  horizontal 1D smoothing kernel (CV_32FC1, 1 x n or n x 1)
+colKernel:  vertical 1D smoothing kernel (CV_32FC1, 1 x m or m x 1)
+thresh:     minimal difference between image and smoothed image
+scale:      scaling of the difference
+return:     sharpened image
+*/
+Mat ConvEngine::unsharpMask(Mat& src, Mat& rowKernel, Mat& colKernel, double thresh, double scale){
+
+   return separable(src, rowKernel, colKernel, true, (float)thresh, (float)scale);
+}
+
+// separable convolution or unsharp masking, tile by tile
+/*
+src:        input image (CV_32FC1)
+rowKernel:  horizontal 1D kernel
+colKernel:  vertical 1D kernel
+sharpen:    unsharp masking if true, convolution otherwise
+thresh:     minimal difference of the unsharp masking
+scale:      scaling of the unsharp masking
+return:     result
+*/
+Mat ConvEngine::separable(Mat& src, Mat& rowKernel, Mat& colKernel, bool sharpen, float thresh, float scale){
+
+   int rowSize = rowKernel.total();
+   int colSize = colKernel.total();
+   Mat output(src.rows, src.cols, CV_32FC1);
+
+   // flip both kernels
+   Mat rowK = rowKernel.clone();
+   Mat colK = colKernel.clone();
+   vector<float> rowFlip(rowSize), colFlip(colSize);
+   for (int l = 0; l < rowSize; l++){
+      rowFlip[l] = rowK.ptr<float>()[rowSize - 1 - l];
+   }
+   for (int k = 0; k < colSize; k++){
+      colFlip[k] = colK.ptr<float>()[colSize - 1 - k];
+   }
+
+   int tileCols = min(src.cols, SEP_TILE_COLS);
+   int tileRows = min(src.rows, SEP_TILE_ROWS);
+   int tilesX = (src.cols + tileCols - 1) / tileCols;
+   int tilesY = (src.rows + tileRows - 1) / tileRows;
+
+   pool.parallelFor(tilesX * tilesY, [&](int t){
+      int x = (t % tilesX) * tileCols;
+      int y = (t / tilesX) * tileRows;
+      Rect tile(x, y, min(tileCols, src.cols - x), min(tileRows, src.rows - y));
+      convolveSeparableTile(src, output, &rowFlip[0], rowSize, &colFlip[0], colSize, tile, sharpen, thresh, scale);
+   });
+
+   return output;
+}
+
+// separable convolution of the output pixels inside of one tile
+/*
+src:      input image
+dst:      output image
+rowFlip:  flipped horizontal kernel
+rowSize:  size of horizontal kernel
+colFlip:  flipped vertical kernel
+colSize:  size of vertical kernel
+tile:     output region to compute
+sharpen:  writes the unsharp masking result instead of the convolution
+thresh:   minimal difference of the unsharp masking
+scale:    scaling of the unsharp masking
+*/
+void ConvEngine::convolveSeparableTile(Mat& src, Mat& dst, const float* rowFlip, int rowSize,
+                                       const float* colFlip, int colSize, Rect tile,
+                                       bool sharpen, float thresh, float scale){
+
+   int rowBefore = (colSize - 1) / 2;
+   int colBefore = (rowSize - 1) / 2;
+   int colAfter = rowSize - 1 - colBefore;
+
+   // columns the horizontal pass needs, the part outside of the image replicates the border columns
+   int first = tile.x - colBefore;
+   int last = tile.x + tile.width + colAfter;
+   int c0 = max(0, first);
+   int c1 = min(src.cols, last);
+   int padLeft = c0 - first;
+   int padRight = last - c1;
+
+   vector<float> line(tile.width + rowSize - 1);
+   vector<float> smooth(sharpen ? tile.width : 0);
+   vector<const float*> rows(colSize);
+
+   for (int i = tile.y; i < tile.y + tile.height; i++){
+      for (int k = 0; k < colSize; k++){
+         int k_src = min(max(i - rowBefore + k, 0), src.rows - 1);
+         rows[k] = src.ptr<float>(k_src);
+      }
+
+      float* v = &line[padLeft];
+      verticalPass(&rows[0], colFlip, colSize, c0, c1, v);
+      for (int p = 0; p < padLeft; p++){
+         line[p] = v[0];
+      }
+      for (int p = 0; p < padRight; p++){
+         v[c1 - c0 + p] = v[c1 - c0 - 1];
+      }
+
+      float* out = dst.ptr<float>(i) + tile.x;
+      if (sharpen){
+         horizontalPass(&line[0], rowFlip, rowSize, tile.width, &smooth[0]);
+         sharpenRow(src.ptr<float>(i) + tile.x, &smooth[0], thresh, scale, tile.width, out);
+      }else{
+         horizontalPass(&line[0], rowFlip, rowSize, tile.width, out);
+      }
+   }
+}
+
+// convolution of the output pixels inside of one tile
+/*
+src:     input image
+dst:     output image
+kFlip:   flipped kernel, kSize*kSize values row by row
+kSize:   kernel size
+tile:    output region to compute
+*/
+void ConvEngine::convolveTile(Mat& src, Mat& dst, const float* kFlip, int kSize, Rect tile){
+
+   // the taps of pixel (i,j) cover rows i-before .. i+after (same for columns)
+   int before = (kSize - 1) / 2;
+   int after = kSize - 1 - before;
+
+   // interior = all pixels whose taps lie inside the image, no clamping needed there
+   int rowBegin = min(before, src.rows);
+   int rowEnd = max(rowBegin, src.rows - after);
+   int colBegin = min(before, src.cols);
+   int colEnd = max(colBegin, src.cols - after);
+
+   // interior columns of this tile
+   int tileEnd = tile.x + tile.width;
+   colBegin = min(max(colBegin, tile.x), tileEnd);
+   colEnd = max(min(colEnd, tileEnd), colBegin);
+
+   for (int i = tile.y; i < tile.y + tile.height; i++){
+
+      float* out = dst.ptr<float>(i);
+
+      if ( (i < rowBegin) || (i >= rowEnd) ){
+         // border band: replicate the border by clamping every tap
+         for (int j = tile.x; j < tileEnd; j++){
+            out[j] = convolvePixelClamped(src, kFlip, kSize, i, j);
+         }
+         continue;
+      }
+
+      for (int j = tile.x; j < colBegin; j++){
+         out[j] = convolvePixelClamped(src, kFlip, kSize, i, j);
+      }
+      convolveRowInterior(src, kFlip, kSize, i, colBegin, colEnd, out);
+      for (int j = colEnd; j < tileEnd; j++){
+         out[j] = convolvePixelClamped(src, kFlip, kSize, i, j);
+      }
+   }
+}
+
+// convolution result of one pixel, taps outside the image are clamped to the border
+/*
+src:     input image
+kFlip:   flipped kernel, kSize*kSize values row by row
+kSize:   kernel size
+i, j:    position of the output pixel
+return:  convolution result at (i,j)
+*/
+float ConvEngine::convolvePixelClamped(Mat& src, const float* kFlip, int kSize, int i, int j){
+
+   float res = 0; //  will contain the sum of all the convoluted terms.
+
+   for (int k = 0; k < kSize; k++){
+      int k_src = i - (kSize - 1) / 2 + k;
+      if (k_src < 0){
+         k_src = 0;
+      }else if (k_src >= src.rows){
+         k_src = src.rows - 1;
+      }
+      const float* s = src.ptr<float>(k_src);
+      for (int l = 0; l < kSize; l++){
+         int l_src = j + l - (kSize - 1) / 2;
+         if (l_src < 0){
+            l_src = 0;
+         }else if (l_src >= src.cols){
+            l_src = src.cols - 1;
+         }
+         res = res + s[l_src] * kFlip[k*kSize + l];
+      }
+   }
+
+   return res;
+}
+
+// convolution of the interior pixels jBegin..jEnd-1 of row i
+// all taps must lie inside the image. Neighbouring output pixels are computed together
+// in SIMD registers; the taps are summed in the same order as convolvePixelClamped(),
+// so both paths give identical values
+/*
+src:     input image
+kFlip:   flipped kernel, kSize*kSize values row by row
+kSize:   kernel size
+i:       output row
+jBegin:  first output column
+jEnd:    one past the last output column
+out:     pointer to output row i
+*/
+void ConvEngine::convolveRowInterior(Mat& src, const float* kFlip, int kSize, int i, int jBegin, int jEnd, float* out){
+
+   int before = (kSize - 1) / 2;
+   int j = jBegin;
+
+#if defined(__AVX2__)
+   for (; j + 8 <= jEnd; j += 8){
+      __m256 res = _mm256_setzero_ps();
+      for (int k = 0; k < kSize; k++){
+         const float* s = src.ptr<float>(i - before + k) + j - before;
+         const float* w = kFlip + k*kSize;
+         for (int l = 0; l < kSize; l++){
+            res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_loadu_ps(s + l), _mm256_set1_ps(w[l])));
+         }
+      }
+      _mm256_storeu_ps(out + j, res);
+   }
+#endif
+#if defined(__SSE2__)
+   for (; j + 4 <= jEnd; j += 4){
+      __m128 res = _mm_setzero_ps();
+      for (int k = 0; k < kSize; k++){
+         const float* s = src.ptr<float>(i - before + k) + j - before;
+         const float* w = kFlip + k*kSize;
+         for (int l = 0; l < kSize; l++){
+            res = _mm_add_ps(res, _mm_mul_ps(_mm_loadu_ps(s + l), _mm_set1_ps(w[l])));
+         }
+      }
+      _mm_storeu_ps(out + j, res);
+   }
+#endif
+
+   // remaining pixels of the run
+   for (; j < jEnd; j++){
+      float res = 0;
+      for (int k = 0; k < kSize; k++){
+         const float* s = src.ptr<float>(i - before + k) + j - before;
+         const float* w = kFlip + k*kSize;
+         for (int l = 0; l < kSize; l++){
+            res = res + s[l] * w[l];
+         }
+      }
+      out[j] = res;
+   }
+}
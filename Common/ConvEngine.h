@@ -0,0 +1,56 @@
+//============================================================================
+// Name        : ConvEngine.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : tiled multithreaded spatial convolution shared by Dip2 and Dip3
+//============================================================================
+
+#ifndef COMMON_CONVENGINE_H
+#define COMMON_CONVENGINE_H
+
+#include <opencv2/opencv.hpp>
+
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace cv;
+
+class ConvEngine{
+
+   public:
+      // constructor, uses the shared thread pool
+      ConvEngine(void) : pool(ThreadPool::instance()){};
+      // constructor, uses the given thread pool
+      ConvEngine(ThreadPool& p) : pool(p){};
+      // destructor
+      ~ConvEngine(void){};
+
+      // convolution of a CV_32FC1 image with a square kernel, borders are replicated
+      Mat convolve(Mat& src, Mat& kernel);
+      // convolution with the separable kernel colKernel * rowKernel (both 1D, CV_32FC1), borders are replicated
+      // costs O(k) per pixel instead of O(k*k)
+      Mat convolveSeparable(Mat& src, Mat& rowKernel, Mat& colKernel);
+      // unsharp masking with the separable smoothing kernel colKernel * rowKernel in a single pass
+      // result = src + scale * d where d = src - smooth(src) > thresh, src otherwise
+      // needs no image sized temporaries, only line buffers per tile
+      Mat unsharpMask(Mat& src, Mat& rowKernel, Mat& colKernel, double thresh, double scale);
+
+   private:
+      // convolution of the output pixels inside of tile
+      void convolveTile(Mat& src, Mat& dst, const float* kFlip, int kSize, Rect tile);
+      // one output pixel, taps outside the image are clamped to the border
+      float convolvePixelClamped(Mat& src, const float* kFlip, int kSize, int i, int j);
+      // a run of output pixels of one row whose taps lie inside the image
+      void convolveRowInterior(Mat& src, const float* kFlip, int kSize, int i, int jBegin, int jEnd, float* out);
+      // separable convolution (sharpen = false) or unsharp masking of the whole image
+      Mat separable(Mat& src, Mat& rowKernel, Mat& colKernel, bool sharpen, float thresh, float scale);
+      // separable convolution of the output pixels inside of tile, optionally followed by unsharp masking
+      void convolveSeparableTile(Mat& src, Mat& dst, const float* rowFlip, int rowSize,
+                                 const float* colFlip, int colSize, Rect tile,
+                                 bool sharpen, float thresh, float scale);
+
+      ThreadPool& pool;
+};
+
+#endif
@@ -0,0 +1,198 @@
+//============================================================================
+// Name        : GaussianBank.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description :
+//============================================================================
+
+#include "GaussianBank.h"
+
+#include <cmath>
+#include <cstring>
+
+// the shared bank
+GaussianBank& GaussianBank::instance(void){
+
+   static GaussianBank bank;
+   return bank;
+}
+
+// copies a compile-time table into a 1 x n kernel
+template<typename Table>
+static Mat fromTable(void){
+
+   Mat kernel(1, Table::size, CV_32FC1);
+   memcpy(kernel.ptr<float>(0), Table::weights, Table::size * sizeof(float));
+   return kernel;
+}
+
+// Computes the normalized 1D gaussian
+// one exp() per tap, the small kernels of standard deviation one come from the compile-time tables
+/*
+size:    number of taps
+sigma:   standard deviation
+return:  1 x size kernel
+*/
+Mat GaussianBank::compute1D(int size, double sigma){
+
+   if (sigma == 1.0){
+      switch(size){
+         case 3: return fromTable<Gaussian3>();
+         case 5: return fromTable<Gaussian5>();
+         case 7: return fromTable<Gaussian7>();
+         case 9: return fromTable<Gaussian9>();
+      }
+   }
+
+   Mat kernel(1, size, CV_32FC1);
+   float* k = kernel.ptr<float>(0);
+   double mean = size/2;
+   double c = -0.5 / (sigma * sigma);
+
+   double sum = 0;
+   for (int x = 0; x < size; x++){
+      k[x] = exp(c * (x - mean) * (x - mean));
+      sum += k[x];
+   }
+   for (int x = 0; x < size; x++){
+      k[x] /= sum;
+   }
+   return kernel;
+}
+
+bool GaussianBank::Key::operator<(const Key& k) const{
+
+   if (dims != k.dims){
+      return dims < k.dims;
+   }
+   if (size != k.size){
+      return size < k.size;
+   }
+   return sigma < k.sigma;
+}
+
+// 1D gaussian kernel, computed on the first request
+/*
+size:    number of taps
+sigma:   standard deviation
+return:  1 x size kernel, a copy of the cached one
+*/
+Mat GaussianBank::kernel1D(int size, double sigma){
+
+   if (size < 1 || !(sigma > 0)){
+      cerr << "ERROR: GaussianBank::kernel1D(): invalid size " << size << " or sigma " << sigma << endl;
+      return Mat();
+   }
+
+   lock_guard<mutex> guard(lock);
+   return lookup(1, size, sigma).clone();
+}
+
+// 2D gaussian kernel, the outer product of the 1D factor
+/*
+size:    number of rows and columns
+sigma:   standard deviation
+return:  size x size kernel, a copy of the cached one
+*/
+Mat GaussianBank::kernel2D(int size, double sigma){
+
+   if (size < 1 || !(sigma > 0)){
+      cerr << "ERROR: GaussianBank::kernel2D(): invalid size " << size << " or sigma " << sigma << endl;
+      return Mat();
+   }
+
+   lock_guard<mutex> guard(lock);
+   return lookup(2, size, sigma).clone();
+}
+
+// cached kernel, the least recently used ones are evicted
+/*
+dims:    1 for the 1 x size factor, 2 for the size x size kernel
+size:    number of taps
+sigma:   standard deviation
+return:  kernel shared with the bank
+*/
+Mat GaussianBank::lookup(int dims, int size, double sigma){
+
+   Key key = {dims, size, sigma};
+   map<Key, list<Entry>::iterator>::iterator it = index.find(key);
+   if (it != index.end()){
+      // move to front (most recently used)
+      entries.splice(entries.begin(), entries, it->second);
+      return it->second->kernel;
+   }
+
+   Mat kernel;
+   if (dims == 1){
+      kernel = compute1D(size, sigma);
+   }else{
+      Mat k1 = lookup(1, size, sigma);
+      kernel.create(size, size, CV_32FC1);
+      const float* k = k1.ptr<float>(0);
+      for (int y = 0; y < size; y++){
+         float* row = kernel.ptr<float>(y);
+         for (int x = 0; x < size; x++){
+            row[x] = k[y] * k[x];
+         }
+      }
+   }
+
+   Entry entry;
+   entry.key = key;
+   entry.kernel = kernel;
+   entry.bytes = kernel.total() * kernel.elemSize();
+   if (entry.bytes > capacity){
+      return kernel;
+   }
+   entries.push_front(entry);
+   index[key] = entries.begin();
+   memory += entry.bytes;
+   evict();
+
+   return kernel;
+}
+
+// drops the least recently used entries until the memory cap is met
+void GaussianBank::evict(void){
+
+   while (memory > capacity && !entries.empty()){
+      Entry& last = entries.back();
+      memory -= last.bytes;
+      index.erase(last.key);
+      entries.pop_back();
+   }
+}
+
+void GaussianBank::setCapacity(size_t c){
+
+   lock_guard<mutex> guard(lock);
+   capacity = c;
+   evict();
+}
+
+size_t GaussianBank::getCapacity(void){
+
+   lock_guard<mutex> guard(lock);
+   return capacity;
+}
+
+size_t GaussianBank::getCount(void){
+
+   lock_guard<mutex> guard(lock);
+   return entries.size();
+}
+
+size_t GaussianBank::getMemory(void){
+
+   lock_guard<mutex> guard(lock);
+   return memory;
+}
+
+void GaussianBank::clear(void){
+
+   lock_guard<mutex> guard(lock);
+   entries.clear();
+   index.clear();
+   memory = 0;
+}
@@ -0,0 +1,130 @@
+//============================================================================
+// Name        : GaussianBank.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : cached gaussian kernels and compile-time coefficient tables
+//============================================================================
+
+#ifndef COMMON_GAUSSIANBANK_H
+#define COMMON_GAUSSIANBANK_H
+
+#include <list>
+#include <map>
+#include <mutex>
+
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+// kernels of size n are centered at n/2 and normalized to a sum of one.
+// The 2D kernel is the outer product of the 1D factor with itself.
+// The least recently used kernels are dropped when the memory cap is reached
+class GaussianBank{
+
+   public:
+      // constructor, capacity in bytes
+      GaussianBank(size_t capacity = 4 << 20) : capacity(capacity), memory(0){};
+      // destructor
+      ~GaussianBank(void){};
+
+      // bank shared by all processing routines
+      static GaussianBank& instance(void);
+
+      // 1 x size kernel of standard deviation sigma (CV_32FC1)
+      // the returned kernel is a copy, the caller may change it
+      Mat kernel1D(int size, double sigma);
+      // size x size kernel of standard deviation sigma (CV_32FC1), a copy like kernel1D()
+      Mat kernel2D(int size, double sigma);
+
+      // memory cap in bytes, smaller caps evict immediately
+      void setCapacity(size_t capacity);
+      size_t getCapacity(void);
+      // number and bytes of the cached kernels
+      size_t getCount(void);
+      size_t getMemory(void);
+      // drops all kernels
+      void clear(void);
+
+   private:
+      struct Key{
+         int dims;
+         int size;
+         double sigma;
+         bool operator<(const Key& k) const;
+      };
+      struct Entry{
+         Key key;
+         Mat kernel;
+         size_t bytes;
+      };
+
+      // computes the normalized 1D factor
+      static Mat compute1D(int size, double sigma);
+      // cached 1D (dims 1) or 2D (dims 2) kernel, computed on a miss (lock must be held)
+      Mat lookup(int dims, int size, double sigma);
+      // drops least recently used entries until memory <= capacity (lock must be held)
+      void evict(void);
+
+      mutex lock;
+      // most recently used entry in front
+      list<Entry> entries;
+      map<Key, list<Entry>::iterator> index;
+      size_t capacity;
+      size_t memory;
+};
+
+// compile-time gaussian tables
+// GaussianTable<n, s>::weights holds the same values as GaussianBank::kernel1D(n, s/1000.),
+// templated kernels can use them as constants
+namespace gaussian_detail{
+
+   // exp() is not constexpr: series for |x| <= 1/2, squaring for larger values, reciprocal for negative ones
+   constexpr double square(double x){
+      return x * x;
+   }
+   constexpr double expSeries(double x, double term, int n){
+      return (n > 24) ? term : term + expSeries(x, term * x / (n + 1), n + 1);
+   }
+   constexpr double cexp(double x){
+      return (x < 0) ? 1.0 / cexp(-x) : ((x > 0.5) ? square(cexp(0.5 * x)) : expSeries(x, 1.0, 0));
+   }
+
+   // unnormalized weight of tap i and the sum of the taps i..size-1
+   constexpr double weight(int i, int size, double sigma){
+      return cexp(-0.5 * square((i - size / 2) / sigma));
+   }
+   constexpr double weightSum(int i, int size, double sigma){
+      return (i >= size) ? 0.0 : weight(i, size, sigma) + weightSum(i + 1, size, sigma);
+   }
+
+   // 0, 1, ..., n-1 as a parameter pack
+   template<int... I> struct Indices{};
+   template<int N, int... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...>{};
+   template<int... I> struct MakeIndices<0, I...>{ typedef Indices<I...> type; };
+}
+
+// size taps, standard deviation SigmaMilli / 1000
+template<int Size, int SigmaMilli = 1000, typename Idx = typename gaussian_detail::MakeIndices<Size>::type>
+struct GaussianTable;
+
+template<int Size, int SigmaMilli, int... I>
+struct GaussianTable<Size, SigmaMilli, gaussian_detail::Indices<I...> >{
+   static constexpr int size = Size;
+   static constexpr float weights[Size] = {
+      (float)(gaussian_detail::weight(I, Size, SigmaMilli / 1000.)
+            / gaussian_detail::weightSum(0, Size, SigmaMilli / 1000.))...
+   };
+};
+
+template<int Size, int SigmaMilli, int... I>
+constexpr float GaussianTable<Size, SigmaMilli, gaussian_detail::Indices<I...> >::weights[Size];
+
+// the small kernels of standard deviation one, used by Dip3
+typedef GaussianTable<3> Gaussian3;
+typedef GaussianTable<5> Gaussian5;
+typedef GaussianTable<7> Gaussian7;
+typedef GaussianTable<9> Gaussian9;
+
+#endif
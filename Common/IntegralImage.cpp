@@ -0,0 +1,186 @@
+//============================================================================
+// Name        : IntegralImage.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : 
+//============================================================================
+
+#include "IntegralImage.h"
+
+// rows per task when building the table / filtering
+static const int BAND_ROWS = 64;
+// columns per task of the vertical accumulation
+static const int STRIP_COLS = 256;
+
+// summed-area table
+// accumulated in double, which is exact for integral grey values up to 2^53
+// first every row is summed up (parallel over rows), then the rows are accumulated
+// top to bottom (parallel over column strips, each row access stays contiguous)
+/*
+src:     input image (CV_32FC1)
+return:  table with sat(i,j) = sum of src(0..i-1, 0..j-1)
+*/
+Mat IntegralImage::build(Mat& src){
+
+   Mat sat(src.rows + 1, src.cols + 1, CV_64FC1);
+   fill(src, sat);
+   return sat;
+}
+
+// summed-area table into an existing matrix
+/*
+src:  input image (CV_32FC1)
+sat:  table of size (rows+1) x (cols+1), CV_64FC1 (may be a region of a larger buffer)
+*/
+void IntegralImage::fill(Mat& src, Mat& sat){
+
+   double* top = sat.ptr<double>(0);
+   for (int j = 0; j <= src.cols; j++){
+      top[j] = 0;
+   }
+
+   int bands = (src.rows + BAND_ROWS - 1) / BAND_ROWS;
+   pool.parallelFor(bands, [&](int b){
+      int end = min(src.rows, (b + 1) * BAND_ROWS);
+      for (int i = b * BAND_ROWS; i < end; i++){
+         const float* in = src.ptr<float>(i);
+         double* s = sat.ptr<double>(i + 1);
+         double acc = 0;
+         s[0] = 0;
+         for (int j = 0; j < src.cols; j++){
+            acc += in[j];
+            s[j + 1] = acc;
+         }
+      }
+   });
+
+   int strips = (src.cols + STRIP_COLS) / STRIP_COLS;
+   pool.parallelFor(strips, [&](int t){
+      int begin = t * STRIP_COLS;
+      int end = min(src.cols + 1, begin + STRIP_COLS);
+      for (int i = 2; i <= src.rows; i++){
+         const double* prev = sat.ptr<double>(i - 1);
+         double* s = sat.ptr<double>(i);
+         for (int j = begin; j < end; j++){
+            s[j] += prev[j];
+         }
+      }
+   });
+}
+
+// box filter, borders are replicated
+/*
+src:     input image (CV_32FC1)
+kSize:   width and height of the box
+return:  filtered image
+*/
+Mat IntegralImage::boxFilter(Mat& src, int kSize){
+
+   if (kSize <= 1){
+      return src.clone();
+   }
+
+   // same taps as the spatial convolution: rows i-before .. i+after (same for columns)
+   int before = (kSize - 1) / 2;
+   int after = kSize - 1 - before;
+
+   Mat padded;
+   copyMakeBorder(src, padded, before, after, before, after, BORDER_REPLICATE);
+
+   Mat buffer(padded.rows + 1, padded.cols + 1, CV_64FC1);
+   return boxValid(padded, kSize, buffer);
+}
+
+// gaussian filter approximated by repeated box filters (central limit theorem)
+// the border is padded once by the radius of all boxes together, so the result equals the
+// convolution with the combined kernel of replicated borders (not with re-replicated partial results)
+// the images shrink from pass to pass, so all passes share the table of the first (largest) one
+/*
+src:     input image (CV_32FC1)
+sigma:   standard deviation of the gaussian
+passes:  number of box filters, at least 3
+return:  filtered image
+*/
+Mat IntegralImage::gaussianFilter(Mat& src, double sigma, int passes){
+
+   vector<int> sizes = boxSizes(sigma, max(3, passes));
+
+   int radius = 0;
+   for (size_t p = 0; p < sizes.size(); p++){
+      radius += (sizes[p] - 1) / 2;
+   }
+
+   Mat res;
+   copyMakeBorder(src, res, radius, radius, radius, radius, BORDER_REPLICATE);
+   Mat buffer(res.rows + 1, res.cols + 1, CV_64FC1);
+   for (size_t p = 0; p < sizes.size(); p++){
+      if (sizes[p] > 1){
+         res = boxValid(res, sizes[p], buffer);
+      }
+   }
+
+   return res;
+}
+
+// box filter by four lookups in the summed-area table
+/*
+src:     input image (CV_32FC1), already padded by the box
+kSize:   width and height of the box
+buffer:  memory of the table, at least (rows+1) x (cols+1) CV_64FC1
+return:  filtered image, output pixel (i,j) is the mean of src(i..i+kSize-1, j..j+kSize-1)
+*/
+Mat IntegralImage::boxValid(Mat& src, int kSize, Mat& buffer){
+
+   Mat sat = buffer(Rect(0, 0, src.cols + 1, src.rows + 1));
+   fill(src, sat);
+
+   int rows = src.rows - kSize + 1;
+   int cols = src.cols - kSize + 1;
+   Mat output(rows, cols, CV_32FC1);
+   double norm = 1. / ((double)kSize * kSize);
+
+   int bands = (rows + BAND_ROWS - 1) / BAND_ROWS;
+   pool.parallelFor(bands, [&](int b){
+      int end = min(rows, (b + 1) * BAND_ROWS);
+      for (int i = b * BAND_ROWS; i < end; i++){
+         const double* upper = sat.ptr<double>(i);
+         const double* lower = sat.ptr<double>(i + kSize);
+         float* out = output.ptr<float>(i);
+         for (int j = 0; j < cols; j++){
+            out[j] = (float)((lower[j + kSize] - upper[j + kSize] - lower[j] + upper[j]) * norm);
+         }
+      }
+   });
+
+   return output;
+}
+
+// sizes of the box filters approximating a gaussian
+// passes boxes of the odd widths wl or wl+2, chosen such that the sum of their
+// variances (w*w-1)/12 is as close as possible to sigma*sigma
+/*
+sigma:   standard deviation of the gaussian
+passes:  number of boxes
+return:  box widths
+*/
+vector<int> IntegralImage::boxSizes(double sigma, int passes){
+
+   double wIdeal = sqrt(12 * sigma * sigma / passes + 1);
+   int wl = (int)floor(wIdeal);
+   if (wl % 2 == 0){
+      wl--;
+   }
+   int wu = wl + 2;
+
+   // number of boxes of width wl
+   double mIdeal = (12 * sigma * sigma - passes * wl * wl - 4 * passes * wl - 3 * passes) / (-4. * wl - 4);
+   int m = (int)floor(mIdeal + 0.5);
+   m = min(max(m, 0), passes);
+
+   vector<int> sizes(passes);
+   for (int p = 0; p < passes; p++){
+      sizes[p] = (p < m) ? wl : wu;
+   }
+   return sizes;
+}
@@ -0,0 +1,49 @@
+//============================================================================
+// Name        : IntegralImage.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : summed-area tables, box and approximated gaussian filters
+//============================================================================
+
+#ifndef COMMON_INTEGRALIMAGE_H
+#define COMMON_INTEGRALIMAGE_H
+
+#include <opencv2/opencv.hpp>
+
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace cv;
+
+// every filter costs a constant number of operations per pixel, whatever the kernel size
+class IntegralImage{
+
+   public:
+      // constructor, uses the shared thread pool
+      IntegralImage(void) : pool(ThreadPool::instance()){};
+      // constructor, uses the given thread pool
+      IntegralImage(ThreadPool& p) : pool(p){};
+      // destructor
+      ~IntegralImage(void){};
+
+      // summed-area table of a CV_32FC1 image, (rows+1) x (cols+1) CV_64FC1 with a leading row and column of zeros
+      Mat build(Mat& src);
+      // exact kSize x kSize box filter, borders are replicated
+      Mat boxFilter(Mat& src, int kSize);
+      // gaussian of given standard deviation, approximated by passes (>= 3) box filters
+      Mat gaussianFilter(Mat& src, double sigma, int passes = 3);
+      // odd box sizes whose repeated application has (about) the variance of a gaussian
+      static vector<int> boxSizes(double sigma, int passes);
+
+   private:
+      // writes the summed-area table of src into sat, which is (rows+1) x (cols+1) CV_64FC1
+      void fill(Mat& src, Mat& sat);
+      // box filter of the pixels whose box lies inside of src, result is (rows-kSize+1) x (cols-kSize+1)
+      // the table is built in the top left corner of buffer, at least (rows+1) x (cols+1) CV_64FC1
+      Mat boxValid(Mat& src, int kSize, Mat& buffer);
+
+      ThreadPool& pool;
+};
+
+#endif
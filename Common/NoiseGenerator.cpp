@@ -0,0 +1,133 @@
+//============================================================================
+// Name        : NoiseGenerator.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : 
+//============================================================================
+
+#include "NoiseGenerator.h"
+
+#include "Philox.h"
+
+#include <sstream>
+
+// counter words that separate the random streams of the noise types
+static const uint64_t STREAM_IMPULSE = 1;
+static const uint64_t STREAM_GAUSSIAN = 2;
+
+// rows per parallel task
+static const int BAND_ROWS = 64;
+
+// salt and pepper noise
+/*
+img:     input image (CV_32FC1)
+level:   fraction of pixels set to 0 and (again) fraction set to 255
+seed:    seed of the random numbers
+return:  noisy image
+*/
+Mat NoiseGenerator::impulseNoise(Mat& img, double level, unsigned long long seed){
+
+   Philox rng(seed);
+   Mat out(img.rows, img.cols, CV_32FC1);
+   int numBands = (img.rows + BAND_ROWS - 1) / BAND_ROWS;
+
+   pool.parallelFor(numBands, [&](int band){
+      uint32_t r[4];
+      for (int i = band*BAND_ROWS; i < min(img.rows, (band + 1)*BAND_ROWS); i++){
+         const float* s = img.ptr<float>(i);
+         float* d = out.ptr<float>(i);
+         for (int j = 0; j < img.cols; j++){
+            rng.generate((uint64_t)i*img.cols + j, STREAM_IMPULSE, r);
+            double u = Philox::uniform(r[0]);
+            // same decision as the thresholds of Dip2::generateNoisyImages()
+            if (u <= level){
+               d[j] = 0;
+            }else if (u > 1 - level){
+               d[j] = 255;
+            }else{
+               d[j] = s[j];
+            }
+         }
+      }
+   });
+
+   return out;
+}
+
+// additive gaussian noise
+/*
+img:     input image (CV_32FC1)
+stddev:  standard deviation of the noise
+seed:    seed of the random numbers
+return:  noisy image, cut to [0,255]
+*/
+Mat NoiseGenerator::gaussianNoise(Mat& img, double stddev, unsigned long long seed){
+
+   Philox rng(seed);
+   Mat out(img.rows, img.cols, CV_32FC1);
+   int numBands = (img.rows + BAND_ROWS - 1) / BAND_ROWS;
+
+   pool.parallelFor(numBands, [&](int band){
+      uint32_t r[4];
+      for (int i = band*BAND_ROWS; i < min(img.rows, (band + 1)*BAND_ROWS); i++){
+         const float* s = img.ptr<float>(i);
+         float* d = out.ptr<float>(i);
+         for (int j = 0; j < img.cols; j++){
+            rng.generate((uint64_t)i*img.cols + j, STREAM_GAUSSIAN, r);
+            // Box-Muller, u1 in (0,1]
+            double u1 = (r[0] + 1.) * (1. / 4294967296.);
+            double u2 = r[1] * (1. / 4294967296.);
+            double n = sqrt(-2*log(u1)) * cos(2*M_PI*u2);
+            d[j] = min(255., max(0., s[j] + stddev*n));
+         }
+      }
+   });
+
+   return out;
+}
+
+// writes noisy versions of an image for all noise levels and seeds
+// files are named <prefix>impulse_<level>_s<seed>.pgm and <prefix>gauss_<level>_s<seed>.pgm
+/*
+img:            input image (CV_32FC1)
+impulseLevels:  levels for impulseNoise()
+gaussLevels:    standard deviations for gaussianNoise()
+seeds:          seeds, every level is generated once per seed
+prefix:         path and file name prefix of the output
+return:         number of images that could not be written
+*/
+int NoiseGenerator::generateDataset(Mat& img, const vector<double>& impulseLevels, const vector<double>& gaussLevels,
+                                    const vector<unsigned long long>& seeds, string prefix){
+
+   int numLevels = impulseLevels.size() + gaussLevels.size();
+   int numImages = numLevels * seeds.size();
+   vector<int> failed(numImages, 0);
+
+   // one task per image, generation and writing of different images overlap
+   pool.parallelFor(numImages, [&](int n){
+      int l = n % numLevels;
+      unsigned long long seed = seeds[n / numLevels];
+      bool impulse = l < (int)impulseLevels.size();
+      double level = impulse ? impulseLevels[l] : gaussLevels[l - impulseLevels.size()];
+
+      Mat noisy = impulse ? impulseNoise(img, level, seed) : gaussianNoise(img, level, seed);
+      Mat noisy8;
+      noisy.convertTo(noisy8, CV_8UC1);
+
+      ostringstream fname;
+      fname << prefix << (impulse ? "impulse_" : "gauss_") << level << "_s" << seed << ".pgm";
+      vector<int> params;
+      params.push_back(IMWRITE_PXM_BINARY);
+      params.push_back(1);
+      if (!imwrite(fname.str(), noisy8, params)){
+         failed[n] = 1;
+      }
+   });
+
+   int numFailed = 0;
+   for (int n = 0; n < numImages; n++){
+      numFailed += failed[n];
+   }
+   return numFailed;
+}
@@ -0,0 +1,42 @@
+//============================================================================
+// Name        : NoiseGenerator.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : reproducible synthetic noise, single images and whole datasets
+//============================================================================
+
+#ifndef COMMON_NOISEGENERATOR_H
+#define COMMON_NOISEGENERATOR_H
+
+#include <opencv2/opencv.hpp>
+
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace cv;
+
+// every pixel draws its random numbers from a counter-based generator keyed by the seed,
+// so results are bit-identical whatever the number of threads. The same seed gives the
+// same random field at every noise level
+class NoiseGenerator{
+
+   public:
+      // constructor, uses the shared thread pool
+      NoiseGenerator(void) : pool(ThreadPool::instance()){};
+      // destructor
+      ~NoiseGenerator(void){};
+
+      // salt and pepper noise, a fraction level of the pixels becomes 0, the same fraction 255
+      Mat impulseNoise(Mat& img, double level, unsigned long long seed);
+      // additive gaussian noise, result is cut to [0,255]
+      Mat gaussianNoise(Mat& img, double stddev, unsigned long long seed);
+      // writes one uncompressed image (binary PGM) per noise level and seed
+      int generateDataset(Mat& img, const vector<double>& impulseLevels, const vector<double>& gaussLevels,
+                          const vector<unsigned long long>& seeds, string prefix);
+
+   private:
+      ThreadPool& pool;
+};
+
+#endif
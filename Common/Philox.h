@@ -0,0 +1,58 @@
+//============================================================================
+// Name        : Philox.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : counter-based random numbers (Philox4x32-10, Salmon et al. 2011)
+//============================================================================
+
+#ifndef COMMON_PHILOX_H
+#define COMMON_PHILOX_H
+
+#include <stdint.h>
+
+// the random numbers are a pure function of (seed, counter): any pixel can be generated
+// by any thread in any order and the result is always the same
+class Philox{
+
+   public:
+      // constructor
+      Philox(uint64_t seed){
+         key[0] = (uint32_t)seed;
+         key[1] = (uint32_t)(seed >> 32);
+      };
+      // destructor
+      ~Philox(void){};
+
+      // four random words for the 128 bit counter (ctrLo, ctrHi)
+      void generate(uint64_t ctrLo, uint64_t ctrHi, uint32_t out[4]) const{
+         uint32_t c[4] = { (uint32_t)ctrLo, (uint32_t)(ctrLo >> 32), (uint32_t)ctrHi, (uint32_t)(ctrHi >> 32) };
+         uint32_t k0 = key[0];
+         uint32_t k1 = key[1];
+         for (int round = 0; round < 10; round++){
+            uint64_t p0 = (uint64_t)0xD2511F53u * c[0];
+            uint64_t p1 = (uint64_t)0xCD9E8D57u * c[2];
+            uint32_t n0 = (uint32_t)(p1 >> 32) ^ c[1] ^ k0;
+            uint32_t n2 = (uint32_t)(p0 >> 32) ^ c[3] ^ k1;
+            c[0] = n0;
+            c[1] = (uint32_t)p1;
+            c[2] = n2;
+            c[3] = (uint32_t)p0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+         }
+         for (int i = 0; i < 4; i++){
+            out[i] = c[i];
+         }
+      };
+
+      // uniform number in [0,1) from one random word
+      static double uniform(uint32_t x){
+         return (x >> 8) * (1. / 16777216.);
+      };
+
+   private:
+      uint32_t key[2];
+};
+
+#endif
@@ -0,0 +1,218 @@
+//============================================================================
+// Name        : RecursiveGaussian.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description :
+//============================================================================
+
+#include "RecursiveGaussian.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// columns per task of the vertical passes
+static const int STRIP_COLS = 256;
+// rows filtered together by the horizontal passes, one SIMD lane each
+static const int BLOCK_ROWS = 8;
+
+// smallest standard deviation the approximation is valid for
+static const double MIN_SIGMA = 0.5;
+
+// Filter coefficients of Young and van Vliet, "Recursive implementation of the Gaussian filter" (1995),
+// and the start values of the anti-causal pass of Triggs and Sdika, "Boundary conditions for
+// Young-van Vliet recursive filtering" (2006)
+/*
+sigma:   standard deviation
+return:  coefficients
+*/
+RecursiveGaussian::Coefficients RecursiveGaussian::coefficients(double sigma){
+
+   sigma = max(sigma, MIN_SIGMA);
+   double q = (sigma >= 2.5) ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * sqrt(1 - 0.26891 * sigma);
+   double q2 = q * q;
+   double q3 = q2 * q;
+
+   double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+   double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+   double b2 = -(1.4281 * q2 + 1.26661 * q3);
+   double b3 = 0.422205 * q3;
+
+   Coefficients c;
+   double a1 = c.a[0] = b1 / b0;
+   double a2 = c.a[1] = b2 / b0;
+   double a3 = c.a[2] = b3 / b0;
+   c.b = 1 - (a1 + a2 + a3);
+
+   // maps the deviations of the last three causal outputs from the border value
+   // to the deviations of the anti-causal outputs at n-1, n, n+1
+   double s = 1. / ((1 + a1 - a2 + a3) * (1 - a1 - a2 - a3) * (1 + a2 + (a1 - a3) * a3));
+   c.m[0] = s * (-a3 * a1 + 1 - a3 * a3 - a2);
+   c.m[1] = s * (a3 + a1) * (a2 + a3 * a1);
+   c.m[2] = s * a3 * (a1 + a3 * a2);
+   c.m[3] = s * (a1 + a3 * a2);
+   c.m[4] = -s * (a2 - 1) * (a2 + a3 * a1);
+   c.m[5] = -s * a3 * (a3 * a1 + a3 * a3 + a2 - 1);
+   c.m[6] = s * (a3 * a1 + a2 + a1 * a1 - a2 * a2);
+   c.m[7] = s * (a1 * a2 + a3 * a2 * a2 - a1 * a3 * a3 - a3 * a3 * a3 - a3 * a2 + a3);
+   c.m[8] = s * a3 * (a1 + a3 * a2);
+
+   return c;
+}
+
+// one step of the recursion for neighbouring lines, s = w[0] * x + w[1] * p1 + w[2] * p2 + w[3] * p3
+// the state is kept in double: for large sigma b is small and the feedback amplifies rounding errors by
+// about 1/b, in float the result would drift by up to a grey level
+/*
+x:       input values
+p1:      previous states (one step back)
+p2:      previous states (two steps back)
+p3:      previous states (three steps back), overwritten by the new state
+w:       b, a[0], a[1], a[2]
+lanes:   number of lines
+out:     new state rounded to float, may be x
+*/
+static void recursionStep(const float* x, const double* p1, const double* p2, double* p3,
+                          const double* w, int lanes, float* out){
+
+   int j = 0;
+
+#if defined(__AVX2__)
+   __m256d w0 = _mm256_set1_pd(w[0]), w1 = _mm256_set1_pd(w[1]);
+   __m256d w2 = _mm256_set1_pd(w[2]), w3 = _mm256_set1_pd(w[3]);
+   for (; j + 4 <= lanes; j += 4){
+      __m256d res = _mm256_mul_pd(w0, _mm256_cvtps_pd(_mm_loadu_ps(x + j)));
+      res = _mm256_add_pd(res, _mm256_mul_pd(w1, _mm256_loadu_pd(p1 + j)));
+      res = _mm256_add_pd(res, _mm256_mul_pd(w2, _mm256_loadu_pd(p2 + j)));
+      res = _mm256_add_pd(res, _mm256_mul_pd(w3, _mm256_loadu_pd(p3 + j)));
+      _mm256_storeu_pd(p3 + j, res);
+      _mm_storeu_ps(out + j, _mm256_cvtpd_ps(res));
+   }
+#endif
+#if defined(__SSE2__)
+   __m128d v0 = _mm_set1_pd(w[0]), v1 = _mm_set1_pd(w[1]);
+   __m128d v2 = _mm_set1_pd(w[2]), v3 = _mm_set1_pd(w[3]);
+   for (; j + 2 <= lanes; j += 2){
+      __m128d res = _mm_mul_pd(v0, _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double*)(x + j)))));
+      res = _mm_add_pd(res, _mm_mul_pd(v1, _mm_loadu_pd(p1 + j)));
+      res = _mm_add_pd(res, _mm_mul_pd(v2, _mm_loadu_pd(p2 + j)));
+      res = _mm_add_pd(res, _mm_mul_pd(v3, _mm_loadu_pd(p3 + j)));
+      _mm_storeu_pd(p3 + j, res);
+      _mm_store_sd((double*)(out + j), _mm_castps_pd(_mm_cvtpd_ps(res)));
+   }
+#endif
+
+   for (; j < lanes; j++){
+      double res = w[0] * x[j] + w[1] * p1[j] + w[2] * p2[j] + w[3] * p3[j];
+      p3[j] = res;
+      out[j] = (float)res;
+   }
+}
+
+// causal and anti-causal pass along lanes neighbouring lines of n samples
+// sample k of line j is at in[k * inStep + j], the lines are processed together
+/*
+in:       input samples
+inStep:   distance of consecutive samples of a line
+out:      output samples, may be in
+outStep:  distance of consecutive output samples
+n:        samples per line
+lanes:    number of lines
+c:        filter coefficients
+extra:    buffer of 4 * lanes doubles
+*/
+static void recursiveLines(const float* in, size_t inStep, float* out, size_t outStep, int n, int lanes,
+                           const RecursiveGaussian::Coefficients& c, double* extra){
+
+   const double w[4] = {c.b, c.a[0], c.a[1], c.a[2]};
+
+   // the states of the last three positions, position k in state[k mod 3]
+   double* state[3] = {extra, extra + lanes, extra + 2 * lanes};
+   // border value at the end, in may be overwritten by the causal pass
+   double* last = extra + 3 * lanes;
+   const float* x0 = in;
+   const float* x1 = in + (n - 1) * inStep;
+   for (int j = 0; j < lanes; j++){
+      state[0][j] = state[1][j] = state[2][j] = x0[j];
+      last[j] = x1[j];
+   }
+
+   // causal pass, before the first sample it is in its steady state for the replicated border
+   for (int i = 0; i < n; i++){
+      recursionStep(in + i * inStep, state[(i + 2) % 3], state[(i + 1) % 3], state[i % 3], w, lanes, out + i * outStep);
+   }
+
+   // start values of the anti-causal pass at n-1, n and n+1
+   double* s0 = state[(n + 2) % 3];
+   double* s1 = state[(n + 1) % 3];
+   double* s2 = state[n % 3];
+   float* yLast = out + (n - 1) * outStep;
+   for (int j = 0; j < lanes; j++){
+      double u = last[j];
+      double d0 = s0[j] - u, d1 = s1[j] - u, d2 = s2[j] - u;
+      s0[j] = u + c.b * (c.m[0] * d0 + c.m[1] * d1 + c.m[2] * d2);
+      s2[j] = u + c.b * (c.m[3] * d0 + c.m[4] * d1 + c.m[5] * d2);
+      s1[j] = u + c.b * (c.m[6] * d0 + c.m[7] * d1 + c.m[8] * d2);
+      yLast[j] = (float)s0[j];
+   }
+
+   // anti-causal pass
+   for (int i = n - 2; i >= 0; i--){
+      recursionStep(out + i * outStep, state[(i + 1) % 3], state[(i + 2) % 3], state[i % 3], w, lanes, out + i * outStep);
+   }
+}
+
+// gaussian filter by recursion
+// the vertical passes run along the image rows with all columns of a strip as lanes, the horizontal
+// passes on blocks of BLOCK_ROWS rows that are interleaved into a small buffer (one row per lane)
+/*
+src:     input image (CV_32FC1)
+sigma:   standard deviation
+return:  filtered image
+*/
+Mat RecursiveGaussian::filter(Mat& src, double sigma){
+
+   Mat dst(src.rows, src.cols, CV_32FC1);
+   if (src.empty()){
+      return dst;
+   }
+   Coefficients c = coefficients(sigma);
+
+   int strips = (src.cols + STRIP_COLS - 1) / STRIP_COLS;
+   pool.parallelFor(strips, [&](int t){
+      int x = t * STRIP_COLS;
+      int lanes = min(STRIP_COLS, src.cols - x);
+      vector<double> extra(4 * lanes);
+      recursiveLines(src.ptr<float>(0) + x, src.step1(), dst.ptr<float>(0) + x, dst.step1(),
+                     src.rows, lanes, c, &extra[0]);
+   });
+
+   int blocks = (src.rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+   pool.parallelFor(blocks, [&](int b){
+      int y = b * BLOCK_ROWS;
+      int lanes = min(BLOCK_ROWS, src.rows - y);
+      vector<float> buffer(src.cols * lanes);
+      vector<double> extra(4 * lanes);
+      for (int r = 0; r < lanes; r++){
+         const float* row = dst.ptr<float>(y + r);
+         for (int j = 0; j < src.cols; j++){
+            buffer[j * lanes + r] = row[j];
+         }
+      }
+      recursiveLines(&buffer[0], lanes, &buffer[0], lanes, src.cols, lanes, c, &extra[0]);
+      for (int r = 0; r < lanes; r++){
+         float* row = dst.ptr<float>(y + r);
+         for (int j = 0; j < src.cols; j++){
+            row[j] = buffer[j * lanes + r];
+         }
+      }
+   });
+
+   return dst;
+}
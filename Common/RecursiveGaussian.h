@@ -0,0 +1,50 @@
+//============================================================================
+// Name        : RecursiveGaussian.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : recursive (IIR) gaussian filter of constant cost per pixel
+//============================================================================
+
+#ifndef COMMON_RECURSIVEGAUSSIAN_H
+#define COMMON_RECURSIVEGAUSSIAN_H
+
+#include <opencv2/opencv.hpp>
+
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace cv;
+
+// third order recursive approximation of the gaussian (Young and van Vliet): a causal and an
+// anti-causal pass along every row and every column, 7 multiplications per pixel and pass
+// whatever the standard deviation is. Borders are replicated; the anti-causal pass starts from
+// the exact state of an infinitely replicated border (Triggs and Sdika), so there are no
+// transients at the image borders. Neighbouring lines are filtered together in SIMD registers
+class RecursiveGaussian{
+
+   public:
+      // constructor, uses the shared thread pool
+      RecursiveGaussian(void) : pool(ThreadPool::instance()){};
+      // constructor, uses the given thread pool
+      RecursiveGaussian(ThreadPool& p) : pool(p){};
+      // destructor
+      ~RecursiveGaussian(void){};
+
+      // gaussian of given standard deviation (>= 0.5, smaller ones are raised to 0.5) of a CV_32FC1 image
+      Mat filter(Mat& src, double sigma);
+
+      // filter coefficients: w[n] = b * x[n] + a[0] * w[n-1] + a[1] * w[n-2] + a[2] * w[n-3]
+      // and the matrix m of the anti-causal start values (row major 3 x 3)
+      struct Coefficients{
+         double b;
+         double a[3];
+         double m[9];
+      };
+      static Coefficients coefficients(double sigma);
+
+   private:
+      ThreadPool& pool;
+};
+
+#endif
@@ -0,0 +1,114 @@
+//============================================================================
+// Name        : RestorationContext.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description :
+//============================================================================
+
+#include "RestorationContext.h"
+
+// constructor, computes the filter spectrum
+/*
+psf         :  point spread function which caused the degradation (CV_32FC1)
+size        :  size of the images to restore
+type        :  RESTORE_INVERSE or RESTORE_WIENER
+param       :  epsilon of the inverse filter, signal to noise ratio of the wiener filter
+borderType  :  border policy of the padding (see Spectral)
+*/
+RestorationContext::RestorationContext(Mat& psf, Size size, int type, double param, int borderType)
+   : spectral(borderType), psfSize(psf.size()), size(size), type(type), param(param){
+
+   Size fft = spectral.paddedSize(size, psfSize);
+   // the cached spectrum is shared, Q gets its own memory
+   Mat H = spectral.kernelSpectrum(psf, fft.height, fft.width);
+   Q.create(H.rows, H.cols, CV_32FC1);
+
+   if (type == RESTORE_WIENER){
+      Spectral::wienerSpectrum(H, param, Q);
+   }else{
+      Spectral::inverseSpectrum(H, param * Spectral::maxMagnitude(H), Q);
+   }
+}
+
+// restores one image
+/*
+img      :  degraded image (CV_32FC1)
+return   :  restored image, empty if img has not the size of the context
+*/
+Mat RestorationContext::apply(Mat& img){
+
+   if (img.size() != size){
+      cerr << "ERROR: RestorationContext::apply(): image size " << img.cols << " x " << img.rows
+           << " differs from the context size " << size.width << " x " << size.height << endl;
+      return Mat();
+   }
+
+   Rect roi;
+   Mat padded = spectral.pad(img, psfSize, roi);
+
+   Mat G;
+   dft(padded, G, 0);
+   mulSpectrums(G, Q, G, 0);
+
+   return spectral.backward(G, roi);
+}
+
+// restores one image with recycled buffers
+/*
+img      :  degraded image (CV_32FC1)
+dst      :  restored image, empty if img has not the size of the context
+buffers  :  transform buffers of the calling thread
+*/
+void RestorationContext::apply(Mat& img, Mat& dst, Buffers& buffers){
+
+   if (img.size() != size){
+      cerr << "ERROR: RestorationContext::apply(): image size " << img.cols << " x " << img.rows
+           << " differs from the context size " << size.width << " x " << size.height << endl;
+      dst = Mat();
+      return;
+   }
+
+   Rect roi;
+   spectral.pad(img, psfSize, roi, buffers.padded);
+
+   dft(buffers.padded, buffers.spectrum, 0);
+   mulSpectrums(buffers.spectrum, Q, buffers.spectrum, 0);
+   dft(buffers.spectrum, buffers.result, DFT_INVERSE + DFT_SCALE + DFT_REAL_OUTPUT);
+
+   buffers.result(roi).copyTo(dst);
+}
+
+// radius of the restoration filter
+// the impulse response is the inverse transform of Q; the mass of |q| is summed per ring of
+// constant distance max(|dy|,|dx|) to the origin (wrapped around the borders)
+/*
+tolerance   :  sum of |q| allowed outside of the radius
+return      :  smallest such radius
+*/
+int RestorationContext::support(double tolerance){
+
+   Mat q;
+   dft(Q, q, DFT_INVERSE + DFT_SCALE + DFT_REAL_OUTPUT);
+
+   int limit = min(q.rows, q.cols) / 2;
+   vector<double> ring(max(q.rows, q.cols) / 2 + 1, 0.);
+   for(int y = 0; y < q.rows; y++){
+      const float* r = q.ptr<float>(y);
+      int dy = min(y, q.rows - y);
+      for(int x = 0; x < q.cols; x++){
+         ring[max(dy, min(x, q.cols - x))] += fabs(r[x]);
+      }
+   }
+
+   double outside = 0;
+   for(size_t r = limit + 1; r < ring.size(); r++){
+      outside += ring[r];
+   }
+   int radius = limit;
+   while (radius > 0 && outside + ring[radius] <= tolerance){
+      outside += ring[radius];
+      radius--;
+   }
+   return radius;
+}
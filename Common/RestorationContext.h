@@ -0,0 +1,67 @@
+//============================================================================
+// Name        : RestorationContext.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : inverse/wiener restoration of many images with one filter spectrum
+//============================================================================
+
+#ifndef COMMON_RESTORATIONCONTEXT_H
+#define COMMON_RESTORATIONCONTEXT_H
+
+#include <opencv2/opencv.hpp>
+
+#include "Spectral.h"
+
+using namespace std;
+using namespace cv;
+
+// kind of restoration filter
+enum RestorationType{
+   RESTORE_INVERSE = 0,    // inverse filter, parameter: relative threshold epsilon of |H|
+   RESTORE_WIENER = 1      // wiener filter, parameter: signal to noise ratio
+};
+
+// the padded PSF spectrum and the filter spectrum Q are computed once for a (PSF, image size,
+// parameter) combination; every image then costs one forward and one inverse transform and a
+// multiplication of spectra. apply() only reads the context and may run in several threads at once
+class RestorationContext{
+
+   public:
+      // constructor, the images to restore have the given size, borders are padded by borderType
+      RestorationContext(Mat& psf, Size size, int type, double param, int borderType = BORDER_WRAP);
+      // destructor
+      ~RestorationContext(void){};
+
+      // transform buffers of one thread, reused over the images
+      struct Buffers{
+         Mat padded;
+         Mat spectrum;
+         Mat result;
+      };
+
+      // restores one image of the size given to the constructor (not cut to [0,255])
+      Mat apply(Mat& img);
+      // same as apply(img), without allocations once buffers and dst have been used for an image of this size
+      void apply(Mat& img, Mat& dst, Buffers& buffers);
+
+      // radius of the restoration filter in the spatial domain: the absolute values of its impulse
+      // response outside of the square of this radius sum up to at most tolerance
+      // (at most half the transform size, the response is periodic)
+      int support(double tolerance);
+
+      Size getSize(void){ return size; };
+      int getType(void){ return type; };
+      double getParam(void){ return param; };
+
+   private:
+      Spectral spectral;
+      Size psfSize;
+      Size size;
+      int type;
+      double param;
+      // filter spectrum (CCS) of the padded transform size
+      Mat Q;
+};
+
+#endif
@@ -0,0 +1,665 @@
+//============================================================================
+// Name        : Spectral.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : 
+//============================================================================
+
+#include "Spectral.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// applies an element-wise operation to all frequencies of the packed spectra G, H and X
+// CCS layout of a rows x cols real DFT: column 0 (and column cols-1 for even cols) holds
+// the spectrum of a real column, packed along the rows as Re(0), (Re, Im) pairs and for
+// even rows a last Re. All other columns hold (Re, Im) pairs along the row.
+// The few frequencies of the real columns go through op(gRe, gIm, hRe, hIm, xRe, xIm), the
+// real-only ones with gIm = hIm = 0 and their xIm dropped. The interleaved (Re, Im) pairs of
+// each row go through rowOp(g, h, x, n) at once, which processes n pairs in SIMD registers
+/*
+G, H  :  input spectra
+X     :  output spectrum, may be G or H
+op    :  operation on one frequency
+rowOp :  operation on n consecutive frequencies of a row
+*/
+template<class Op, class RowOp>
+static void forEachCCS(Mat& G, Mat& H, Mat& X, Op op, RowOp rowOp){
+
+   int rows = G.rows;
+   int cols = G.cols;
+   float dropped;
+
+   // the real columns
+   int realCols[2] = {0, cols - 1};
+   int numRealCols = (cols > 1 && cols % 2 == 0) ? 2 : 1;
+   for (int r = 0; r < numRealCols; r++){
+      int c = realCols[r];
+      op(G.at<float>(0, c), 0.f, H.at<float>(0, c), 0.f, X.at<float>(0, c), dropped);
+      for (int i = 1; i + 1 < rows; i += 2){
+         op(G.at<float>(i, c), G.at<float>(i + 1, c), H.at<float>(i, c), H.at<float>(i + 1, c),
+            X.at<float>(i, c), X.at<float>(i + 1, c));
+      }
+      if (rows > 1 && rows % 2 == 0){
+         op(G.at<float>(rows - 1, c), 0.f, H.at<float>(rows - 1, c), 0.f, X.at<float>(rows - 1, c), dropped);
+      }
+   }
+
+   // all other columns
+   int end = (cols % 2 == 0) ? cols - 1 : cols;
+   int pairs = (end - 1) / 2;
+   if (pairs <= 0){
+      return;
+   }
+   for (int i = 0; i < rows; i++){
+      rowOp(G.ptr<float>(i) + 1, H.ptr<float>(i) + 1, X.ptr<float>(i) + 1, pairs);
+   }
+}
+
+#if defined(__AVX2__)
+// g * conj(h) for 4 interleaved complex numbers
+static inline __m256 mulConj(__m256 g, __m256 h){
+   __m256 signIm = _mm256_setr_ps(0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f);
+   __m256 t1 = _mm256_mul_ps(g, _mm256_moveldup_ps(h));                              // (gr hr, gi hr)
+   __m256 t2 = _mm256_mul_ps(_mm256_permute_ps(g, 0xB1), _mm256_movehdup_ps(h));    // (gi hi, gr hi)
+   return _mm256_add_ps(t1, _mm256_xor_ps(t2, signIm));
+}
+// |h|^2 in both halves of each complex number
+static inline __m256 normSq(__m256 h){
+   __m256 hh = _mm256_mul_ps(h, h);
+   return _mm256_add_ps(hh, _mm256_permute_ps(hh, 0xB1));
+}
+#endif
+#if defined(__SSE2__)
+// g * conj(h) for 2 interleaved complex numbers
+static inline __m128 mulConj(__m128 g, __m128 h){
+   __m128 signIm = _mm_setr_ps(0.f, -0.f, 0.f, -0.f);
+   __m128 t1 = _mm_mul_ps(g, _mm_shuffle_ps(h, h, _MM_SHUFFLE(2, 2, 0, 0)));
+   __m128 t2 = _mm_mul_ps(_mm_shuffle_ps(g, g, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(h, h, _MM_SHUFFLE(3, 3, 1, 1)));
+   return _mm_add_ps(t1, _mm_xor_ps(t2, signIm));
+}
+// |h|^2 in both halves of each complex number
+static inline __m128 normSq(__m128 h){
+   __m128 hh = _mm_mul_ps(h, h);
+   return _mm_add_ps(hh, _mm_shuffle_ps(hh, hh, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+#endif
+
+// division of n interleaved complex numbers in one pass
+// x = g * conj(h) / (|h|^2 + noise) where |h|^2 > T2, x = g * invT otherwise
+// (wiener filter: T2 < 0, inverse filter: noise = 0)
+/*
+g        :  numerator
+h        :  denominator
+x        :  result, may be g or h
+n        :  number of complex numbers
+noise    :  added to |h|^2
+T2       :  threshold of |h|^2
+invT     :  factor below the threshold
+*/
+static void divideRow(const float* g, const float* h, float* x, int n, float noise, float T2, float invT){
+
+   int j = 0;
+   n *= 2;
+
+#if defined(__AVX2__)
+   __m256 noise8 = _mm256_set1_ps(noise), T28 = _mm256_set1_ps(T2), invT8 = _mm256_set1_ps(invT);
+   for (; j + 8 <= n; j += 8){
+      __m256 gv = _mm256_loadu_ps(g + j);
+      __m256 hv = _mm256_loadu_ps(h + j);
+      __m256 d = normSq(hv);
+      __m256 q = _mm256_div_ps(mulConj(gv, hv), _mm256_add_ps(d, noise8));
+      _mm256_storeu_ps(x + j, _mm256_blendv_ps(_mm256_mul_ps(gv, invT8), q, _mm256_cmp_ps(d, T28, _CMP_GT_OQ)));
+   }
+#endif
+#if defined(__SSE2__)
+   __m128 noise4 = _mm_set1_ps(noise), T24 = _mm_set1_ps(T2), invT4 = _mm_set1_ps(invT);
+   for (; j + 4 <= n; j += 4){
+      __m128 gv = _mm_loadu_ps(g + j);
+      __m128 hv = _mm_loadu_ps(h + j);
+      __m128 d = normSq(hv);
+      __m128 q = _mm_div_ps(mulConj(gv, hv), _mm_add_ps(d, noise4));
+      __m128 mask = _mm_cmpgt_ps(d, T24);
+      _mm_storeu_ps(x + j, _mm_or_ps(_mm_and_ps(mask, q), _mm_andnot_ps(mask, _mm_mul_ps(gv, invT4))));
+   }
+#endif
+
+   for (; j < n; j += 2){
+      float gr = g[j], gi = g[j + 1], hr = h[j], hi = h[j + 1];
+      float d = hr*hr + hi*hi;
+      if (d > T2){
+         float inv = 1.f / (d + noise);
+         x[j] = (gr*hr + gi*hi) * inv;
+         x[j + 1] = (gi*hr - gr*hi) * inv;
+      }else{
+         x[j] = gr * invT;
+         x[j + 1] = gi * invT;
+      }
+   }
+}
+
+// largest |h|^2 of n interleaved complex numbers
+/*
+h        :  complex numbers
+n        :  number of complex numbers
+return   :  max |h|^2
+*/
+static float maxNormRow(const float* h, int n){
+
+   int j = 0;
+   n *= 2;
+   float m = 0;
+
+#if defined(__AVX2__)
+   __m256 m8 = _mm256_setzero_ps();
+   for (; j + 8 <= n; j += 8){
+      m8 = _mm256_max_ps(m8, normSq(_mm256_loadu_ps(h + j)));
+   }
+   float lanes8[8];
+   _mm256_storeu_ps(lanes8, m8);
+   for (int l = 0; l < 8; l++){
+      m = max(m, lanes8[l]);
+   }
+#endif
+#if defined(__SSE2__)
+   __m128 m4 = _mm_setzero_ps();
+   for (; j + 4 <= n; j += 4){
+      m4 = _mm_max_ps(m4, normSq(_mm_loadu_ps(h + j)));
+   }
+   float lanes4[4];
+   _mm_storeu_ps(lanes4, m4);
+   for (int l = 0; l < 4; l++){
+      m = max(m, lanes4[l]);
+   }
+#endif
+
+   for (; j < n; j += 2){
+      m = max(m, h[j]*h[j] + h[j + 1]*h[j + 1]);
+   }
+   return m;
+}
+
+// the complex number 1 repeated n times, numerator of the filter spectra
+static vector<float> onesRow(int n){
+
+   vector<float> ones(2 * n, 0.f);
+   for (int j = 0; j < n; j++){
+      ones[2 * j] = 1.f;
+   }
+   return ones;
+}
+
+// size of the transform
+// the image is extended by the kernel size (no wrap-around of the kernel into the image),
+// then up to the next fast DFT size
+/*
+image    :  image size
+kernel   :  kernel size
+return   :  transform size
+*/
+Size Spectral::paddedSize(Size image, Size kernel){
+
+   if (borderType == BORDER_WRAP
+       && getOptimalDFTSize(image.width) == image.width && getOptimalDFTSize(image.height) == image.height){
+      // circular convolution is what the DFT computes anyway
+      return image;
+   }
+   return Size(getOptimalDFTSize(image.width + kernel.width - 1), getOptimalDFTSize(image.height + kernel.height - 1));
+}
+
+// pads the image by the border policy
+/*
+img      :  input image
+kernel   :  kernel size
+roi      :  receives the position of the image inside of the padded image
+return   :  padded image (img itself if no padding is needed)
+*/
+Mat Spectral::pad(Mat& img, Size kernel, Rect& roi){
+
+   Mat padded;
+   pad(img, kernel, roi, padded);
+   return padded;
+}
+
+// pads the image into a buffer
+/*
+img      :  input image
+kernel   :  kernel size
+roi      :  receives the position of the image inside of the padded image
+padded   :  padded image (shares the data of img if no padding is needed)
+*/
+void Spectral::pad(Mat& img, Size kernel, Rect& roi, Mat& padded){
+
+   Size size = paddedSize(img.size(), kernel);
+
+   // output pixel i uses the input pixels i-(k-1-k/2) .. i+k/2 (see kernelSpectrum())
+   int top = (size.height == img.rows) ? 0 : kernel.height - 1 - kernel.height / 2;
+   int left = (size.width == img.cols) ? 0 : kernel.width - 1 - kernel.width / 2;
+   roi = Rect(left, top, img.cols, img.rows);
+
+   if (size == img.size()){
+      padded = img;
+      return;
+   }
+
+   copyMakeBorder(img, padded, top, size.height - img.rows - top, left, size.width - img.cols - left, borderType);
+}
+
+// packed spectrum of a kernel whose center (rows/2, cols/2) is moved to the origin
+/*
+kernel   :  filter kernel (CV_32FC1)
+rows     :  rows of the transform
+cols     :  columns of the transform
+return   :  CCS spectrum, shared with the spectrum cache (must not be changed)
+*/
+Mat Spectral::kernelSpectrum(Mat& kernel, int rows, int cols){
+
+   return SpectrumCache::instance().get(kernel, rows, cols, SPECTRUM_CCS, [&](){
+
+      // zeroed buffer reused by all misses of this thread: the kernel is written in,
+      // transformed and cleared again, no image sized allocation or pass per call
+      static thread_local Mat buffer;
+      if (buffer.rows != rows || buffer.cols != cols){
+         buffer = Mat::zeros(rows, cols, CV_32FC1);
+      }
+
+      wrapKernel(kernel, buffer);
+      Mat H;
+      dft(buffer, H, 0);
+      wrapKernel(kernel, buffer, true);
+      return H;
+   });
+}
+
+// writes a kernel wrapped around the borders into a buffer
+// each kernel row lands in at most two contiguous pieces of one buffer row
+/*
+kernel   :  filter kernel (CV_32FC1)
+buffer   :  CV_32FC1 buffer, zero at the kernel positions
+clear    :  write zeros instead of the kernel values
+*/
+void Spectral::wrapKernel(Mat& kernel, Mat& buffer, bool clear){
+
+   int rows = buffer.rows;
+   int cols = buffer.cols;
+   int cy = kernel.rows / 2;
+   int cx = kernel.cols / 2;
+
+   if (kernel.rows > rows || kernel.cols > cols){
+      // kernel larger than the buffer, several taps fall onto the same position
+      for (int i = 0; i < kernel.rows; i++){
+         int y = ((i - cy) % rows + rows) % rows;
+         for (int j = 0; j < kernel.cols; j++){
+            int x = ((j - cx) % cols + cols) % cols;
+            buffer.at<float>(y, x) = clear ? 0.f : buffer.at<float>(y, x) + kernel.at<float>(i, j);
+         }
+      }
+      return;
+   }
+
+   for (int i = 0; i < kernel.rows; i++){
+      int y = (i - cy + rows) % rows;
+      const float* k = kernel.ptr<float>(i);
+      float* b = buffer.ptr<float>(y);
+      // columns 0 .. cx-1 wrap to the end of the row, cx .. k-1 go to its start
+      if (clear){
+         memset(b + cols - cx, 0, cx * sizeof(float));
+         memset(b, 0, (kernel.cols - cx) * sizeof(float));
+      }else{
+         memcpy(b + cols - cx, k, cx * sizeof(float));
+         memcpy(b, k + cx, (kernel.cols - cx) * sizeof(float));
+      }
+   }
+}
+
+// circular shift by copying row blocks
+// every destination row gets its source row in two pieces; for a continuous matrix
+// without column shift the whole matrix is moved in two blocks
+/*
+in       :  input matrix
+dx       :  shift in x-direction (columns)
+dy       :  shift in y-direction (rows)
+return   :  circular shifted matrix
+*/
+Mat Spectral::circShift(const Mat& in, int dx, int dy){
+
+   Mat out(in.rows, in.cols, in.type());
+   if (in.empty()){
+      return out;
+   }
+
+   int rows = in.rows;
+   int cols = in.cols;
+   int sy = ((dy % rows) + rows) % rows;
+   int sx = ((dx % cols) + cols) % cols;
+   size_t es = in.elemSize();
+
+   if (sx == 0 && in.isContinuous()){
+      // rows 0 .. rows-sy-1 move down by sy, the last sy rows to the top
+      size_t rowBytes = cols * es;
+      memcpy(out.ptr(sy), in.ptr(0), (rows - sy) * rowBytes);
+      memcpy(out.ptr(0), in.ptr(rows - sy), sy * rowBytes);
+      return out;
+   }
+
+   for (int y = 0; y < rows; y++){
+      const uchar* src = in.ptr((y - sy + rows) % rows);
+      uchar* dst = out.ptr(y);
+      memcpy(dst + sx * es, src, (cols - sx) * es);
+      memcpy(dst, src + (cols - sx) * es, sx * es);
+   }
+
+   return out;
+}
+
+// inverse transform and removal of the padding
+/*
+spectrum :  packed spectrum of the padded result
+roi      :  position of the image inside of the padded image
+return   :  real result of image size
+*/
+Mat Spectral::backward(Mat& spectrum, Rect roi){
+
+   Mat out;
+   dft(spectrum, out, DFT_INVERSE + DFT_SCALE + DFT_REAL_OUTPUT);
+
+   if (roi.size() == out.size()){
+      return out;
+   }
+   return out(roi).clone();
+}
+
+// convolution by multiplication of packed spectra
+/*
+img      :  input image (CV_32FC1)
+kernel   :  filter kernel (CV_32FC1)
+return   :  convolution result
+*/
+Mat Spectral::convolve(Mat& img, Mat& kernel){
+
+   if (tileSize > 0 && (img.rows > tileSize || img.cols > tileSize)){
+      return convolveTiled(img, kernel);
+   }
+
+   Rect roi;
+   Mat padded = pad(img, kernel.size(), roi);
+
+   Mat G;
+   dft(padded, G, 0);
+   Mat H = kernelSpectrum(kernel, G.rows, G.cols);
+
+   mulSpectrums(G, H, G, 0);
+
+   return backward(G, roi);
+}
+
+// convolution by overlap-save
+// every output tile is computed from its input window (tile plus kernel sized halo, read
+// through the border policy) by one transform of size getOptimalDFTSize(tileSize + k - 1).
+// The halo keeps the circular wrap-around of the transform out of the tile, so the result
+// equals the convolution of the whole padded image. Tiles are independent and run in parallel
+/*
+img      :  input image (CV_32FC1)
+kernel   :  filter kernel (CV_32FC1)
+return   :  convolution result
+*/
+Mat Spectral::convolveTiled(Mat& img, Mat& kernel){
+
+   // output pixel i uses the input pixels i-top .. i-top+k-1 (see pad())
+   int top = kernel.rows - 1 - kernel.rows / 2;
+   int left = kernel.cols - 1 - kernel.cols / 2;
+
+   // transform size, the tiles use all of it that is not needed for the halo
+   int fftRows = getOptimalDFTSize(min(tileSize, img.rows) + kernel.rows - 1);
+   int fftCols = getOptimalDFTSize(min(tileSize, img.cols) + kernel.cols - 1);
+   int tileRows = fftRows - kernel.rows + 1;
+   int tileCols = fftCols - kernel.cols + 1;
+
+   Mat H = kernelSpectrum(kernel, fftRows, fftCols);
+
+   // source row/column of every position of the padded image (-1: outside, constant border)
+   vector<int> rowMap(img.rows + kernel.rows - 1);
+   vector<int> colMap(img.cols + kernel.cols - 1);
+   for (size_t p = 0; p < rowMap.size(); p++){
+      rowMap[p] = borderInterpolate((int)p - top, img.rows, borderType);
+   }
+   for (size_t p = 0; p < colMap.size(); p++){
+      colMap[p] = borderInterpolate((int)p - left, img.cols, borderType);
+   }
+
+   Mat output(img.rows, img.cols, CV_32FC1);
+   int tilesY = (img.rows + tileRows - 1) / tileRows;
+   int tilesX = (img.cols + tileCols - 1) / tileCols;
+
+   pool.parallelFor(tilesY * tilesX, [&](int t){
+      int y0 = (t / tilesX) * tileRows;
+      int x0 = (t % tilesX) * tileCols;
+      int th = min(tileRows, img.rows - y0);
+      int tw = min(tileCols, img.cols - x0);
+
+      // input window, zero behind the window
+      Mat window = Mat::zeros(fftRows, fftCols, CV_32FC1);
+      for (int r = 0; r < th + kernel.rows - 1; r++){
+         int sy = rowMap[y0 + r];
+         if (sy < 0){
+            continue;
+         }
+         const float* in = img.ptr<float>(sy);
+         float* w = window.ptr<float>(r);
+         for (int c = 0; c < tw + kernel.cols - 1; c++){
+            int sx = colMap[x0 + c];
+            w[c] = (sx < 0) ? 0.f : in[sx];
+         }
+      }
+
+      dft(window, window, 0);
+      mulSpectrums(window, H, window, 0);
+      dft(window, window, DFT_INVERSE + DFT_SCALE + DFT_REAL_OUTPUT);
+
+      for (int r = 0; r < th; r++){
+         const float* w = window.ptr<float>(r + top) + left;
+         float* out = output.ptr<float>(y0 + r) + x0;
+         for (int c = 0; c < tw; c++){
+            out[c] = w[c];
+         }
+      }
+   });
+
+   return output;
+}
+
+// inverse filter on packed spectra
+/*
+img      :  degraded image (CV_32FC1)
+kernel   :  kernel which caused the degradation
+epsilon  :  relative threshold of the filter magnitude
+return   :  restored image
+*/
+Mat Spectral::inverseFilter(Mat& img, Mat& kernel, double epsilon){
+
+   Rect roi;
+   Mat padded = pad(img, kernel.size(), roi);
+
+   Mat G;
+   dft(padded, G, 0);
+   Mat H = kernelSpectrum(kernel, G.rows, G.cols);
+
+   inverseDivide(G, H, epsilon * maxMagnitude(H), G);
+
+   return backward(G, roi);
+}
+
+// wiener filter on packed spectra
+/*
+img      :  degraded image (CV_32FC1)
+kernel   :  kernel which caused the degradation
+snr      :  signal to noise ratio
+return   :  restored image
+*/
+Mat Spectral::wienerFilter(Mat& img, Mat& kernel, double snr){
+
+   Rect roi;
+   Mat padded = pad(img, kernel.size(), roi);
+
+   Mat G;
+   dft(padded, G, 0);
+   Mat H = kernelSpectrum(kernel, G.rows, G.cols);
+
+   wienerDivide(G, H, snr, G);
+
+   return backward(G, roi);
+}
+
+// wiener filters for a sweep of signal to noise ratios
+// only the 1/snr^2 term of the filter differs, so the image and kernel spectra are shared:
+// every ratio costs one division pass and one inverse transform
+/*
+img      :  degraded image (CV_32FC1)
+kernel   :  kernel which caused the degradation
+snrs     :  signal to noise ratios
+parallel :  process the ratios in parallel (one spectrum sized buffer per running ratio)
+return   :  restored image per ratio, in the order of snrs
+*/
+vector<Mat> Spectral::wienerSweep(Mat& img, Mat& kernel, const vector<double>& snrs, bool parallel){
+
+   vector<Mat> restored(snrs.size());
+   if (snrs.empty()){
+      return restored;
+   }
+
+   Rect roi;
+   Mat padded = pad(img, kernel.size(), roi);
+
+   Mat G;
+   dft(padded, G, 0);
+   Mat H = kernelSpectrum(kernel, G.rows, G.cols);
+
+   function<void(int)> restore = [&](int i){
+      Mat X(G.rows, G.cols, CV_32FC1);
+      wienerDivide(G, H, snrs[i], X);
+      restored[i] = backward(X, roi);
+   };
+   if (parallel){
+      pool.parallelFor((int)snrs.size(), restore);
+   }else{
+      for (size_t i = 0; i < snrs.size(); i++){
+         restore((int)i);
+      }
+   }
+
+   return restored;
+}
+
+// largest magnitude of a packed spectrum
+/*
+H        :  CCS spectrum
+return   :  max |H|
+*/
+double Spectral::maxMagnitude(Mat& H){
+
+   double maxSq = 0;
+   forEachCCS(H, H, H, [&](float hr, float hi, float, float, float&, float&){
+      maxSq = max(maxSq, (double)hr*hr + (double)hi*hi);
+   }, [&](const float*, const float* h, float*, int n){
+      maxSq = max(maxSq, (double)maxNormRow(h, n));
+   });
+   return sqrt(maxSq);
+}
+
+// inverse filter division X = G * conj(H) / |H|^2 (= G / H) where |H| > T, X = G / T otherwise
+/*
+G        :  spectrum of the degraded image
+H        :  spectrum of the kernel
+T        :  threshold of the magnitude
+X        :  result, may be G
+*/
+void Spectral::inverseDivide(Mat& G, Mat& H, double T, Mat& X){
+
+   float invT = (float)(1. / T);
+   float T2 = (float)(T * T);
+   forEachCCS(G, H, X, [&](float gr, float gi, float hr, float hi, float& xr, float& xi){
+      float d = hr*hr + hi*hi;
+      if (d > T2){
+         float inv = 1.f / d;
+         xr = (gr*hr + gi*hi) * inv;
+         xi = (gi*hr - gr*hi) * inv;
+      }else{
+         xr = gr * invT;
+         xi = gi * invT;
+      }
+   }, [&](const float* g, const float* h, float* x, int n){
+      divideRow(g, h, x, n, 0.f, T2, invT);
+   });
+}
+
+// wiener filter division X = G * conj(H) / (|H|^2 + 1/snr^2)
+/*
+G        :  spectrum of the degraded image
+H        :  spectrum of the kernel
+snr      :  signal to noise ratio
+X        :  result, may be G
+*/
+void Spectral::wienerDivide(Mat& G, Mat& H, double snr, Mat& X){
+
+   float noise = (float)(1. / (snr * snr));
+   forEachCCS(G, H, X, [&](float gr, float gi, float hr, float hi, float& xr, float& xi){
+      float inv = 1.f / (hr*hr + hi*hi + noise);
+      xr = (gr*hr + gi*hi) * inv;
+      xi = (gi*hr - gr*hi) * inv;
+   }, [&](const float* g, const float* h, float* x, int n){
+      divideRow(g, h, x, n, noise, -1.f, 0.f);
+   });
+}
+
+// spectrum of the inverse filter
+// same division as inverseDivide() with G = 1
+/*
+H        :  spectrum of the kernel
+T        :  threshold of the magnitude
+Q        :  result, may be H
+*/
+void Spectral::inverseSpectrum(Mat& H, double T, Mat& Q){
+
+   float invT = (float)(1. / T);
+   float T2 = (float)(T * T);
+   vector<float> ones = onesRow(H.cols / 2);
+   forEachCCS(H, H, Q, [&](float hr, float hi, float, float, float& qr, float& qi){
+      float d = hr*hr + hi*hi;
+      if (d > T2){
+         float inv = 1.f / d;
+         qr = hr * inv;
+         qi = -hi * inv;
+      }else{
+         qr = invT;
+         qi = 0;
+      }
+   }, [&](const float*, const float* h, float* q, int n){
+      divideRow(&ones[0], h, q, n, 0.f, T2, invT);
+   });
+}
+
+// spectrum of the wiener filter
+// same division as wienerDivide() with G = 1
+/*
+H        :  spectrum of the kernel
+snr      :  signal to noise ratio
+Q        :  result, may be H
+*/
+void Spectral::wienerSpectrum(Mat& H, double snr, Mat& Q){
+
+   float noise = (float)(1. / (snr * snr));
+   vector<float> ones = onesRow(H.cols / 2);
+   forEachCCS(H, H, Q, [&](float hr, float hi, float, float, float& qr, float& qi){
+      float inv = 1.f / (hr*hr + hi*hi + noise);
+      qr = hr * inv;
+      qi = -hi * inv;
+   }, [&](const float*, const float* h, float* q, int n){
+      divideRow(&ones[0], h, q, n, noise, -1.f, 0.f);
+   });
+}
@@ -0,0 +1,90 @@
+//============================================================================
+// Name        : Spectral.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : frequency domain filtering on padded, packed (CCS) real spectra
+//============================================================================
+
+#ifndef COMMON_SPECTRAL_H
+#define COMMON_SPECTRAL_H
+
+#include <opencv2/opencv.hpp>
+
+#include "SpectrumCache.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace cv;
+
+// images are padded by the kernel size with a border policy (any OpenCV border type) and
+// further up to a size getOptimalDFTSize() is fast for. All spectra are real DFTs in the
+// packed CCS format, which needs half the memory of DFT_COMPLEX_OUTPUT spectra.
+// BORDER_WRAP keeps circular convolution; images of fast size are not padded at all then.
+// With a tile size > 0 the convolution runs tile by tile (overlap-save): peak memory is a
+// few tile sized buffers per thread instead of several image sized ones
+class Spectral{
+
+   public:
+      // constructor, border policy used for padding, tile size of the convolution (0 = whole image at once)
+      Spectral(int borderType = BORDER_REPLICATE, int tileSize = 0)
+         : borderType(borderType), tileSize(tileSize), pool(ThreadPool::instance()){};
+      // destructor
+      ~Spectral(void){};
+
+      void setBorderType(int type){ borderType = type; };
+      int getBorderType(void){ return borderType; };
+      void setTileSize(int size){ tileSize = size; };
+      int getTileSize(void){ return tileSize; };
+
+      // size of the transform for an image and a kernel of given size
+      Size paddedSize(Size image, Size kernel);
+      // image padded to paddedSize(), roi receives the position of the image inside of it
+      Mat pad(Mat& img, Size kernel, Rect& roi);
+      // same as pad(), the padded image is written into the buffer padded (reallocated only if its size differs)
+      void pad(Mat& img, Size kernel, Rect& roi, Mat& padded);
+      // packed spectrum of kernel, its center moved to the origin of a rows x cols transform (cached)
+      Mat kernelSpectrum(Mat& kernel, int rows, int cols);
+
+      // convolution with kernel
+      Mat convolve(Mat& img, Mat& kernel);
+      // inverse filter, frequencies with |H| < epsilon*max|H| are damped by 1/(epsilon*max|H|)
+      Mat inverseFilter(Mat& img, Mat& kernel, double epsilon);
+      // wiener filter for given signal to noise ratio
+      Mat wienerFilter(Mat& img, Mat& kernel, double snr);
+      // wiener filters for several signal to noise ratios, the forward transforms are computed once
+      // parallel: the ratios are processed at the same time on the thread pool
+      vector<Mat> wienerSweep(Mat& img, Mat& kernel, const vector<double>& snrs, bool parallel = true);
+      // inverse transform of a padded spectrum, cut to roi (see pad())
+      Mat backward(Mat& spectrum, Rect roi);
+
+      // circular shift, element (y,x) moves to ((y+dy) mod rows, (x+dx) mod cols)
+      // copies whole row blocks, any element type
+      static Mat circShift(const Mat& in, int dx, int dy);
+      // writes the kernel into buffer with its center (rows/2, cols/2) at the origin, wrapped around
+      // the borders. Only the kernel positions are written; clear = true writes zeros there instead
+      static void wrapKernel(Mat& kernel, Mat& buffer, bool clear = false);
+
+      // element-wise operations on packed spectra of equal size
+      // largest magnitude of all frequencies
+      static double maxMagnitude(Mat& H);
+      // X = G / H where |H| > T, X = G / T otherwise
+      static void inverseDivide(Mat& G, Mat& H, double T, Mat& X);
+      // X = G * conj(H) / (|H|^2 + 1/snr^2)
+      static void wienerDivide(Mat& G, Mat& H, double snr, Mat& X);
+      // restoration filters as spectra, applying them is a multiplication (mulSpectrums())
+      // Q = conj(H) / |H|^2 where |H| > T, Q = 1 / T otherwise
+      static void inverseSpectrum(Mat& H, double T, Mat& Q);
+      // Q = conj(H) / (|H|^2 + 1/snr^2)
+      static void wienerSpectrum(Mat& H, double snr, Mat& Q);
+
+   private:
+      // convolution by overlap-save of tiles, same result as the whole image transform
+      Mat convolveTiled(Mat& img, Mat& kernel);
+
+      int borderType;
+      int tileSize;
+      ThreadPool& pool;
+};
+
+#endif
@@ -0,0 +1,190 @@
+//============================================================================
+// Name        : SpectrumCache.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : 
+//============================================================================
+
+#include "SpectrumCache.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// capacity of the shared cache if DIP_SPECTRUM_CACHE_MB is not set
+static const size_t DEFAULT_CAPACITY_MB = 256;
+
+// constructor
+/*
+capacity:  memory cap in bytes
+*/
+SpectrumCache::SpectrumCache(size_t capacity) : capacity(capacity), memory(0), hits(0), misses(0){
+}
+
+// the shared cache
+SpectrumCache& SpectrumCache::instance(void){
+
+   static SpectrumCache cache((getenv("DIP_SPECTRUM_CACHE_MB") ? (size_t)atol(getenv("DIP_SPECTRUM_CACHE_MB")) : DEFAULT_CAPACITY_MB) << 20);
+   return cache;
+}
+
+bool SpectrumCache::Key::operator==(const Key& k) const{
+
+   return hash == k.hash && kRows == k.kRows && kCols == k.kCols && kType == k.kType
+       && rows == k.rows && cols == k.cols && layout == k.layout;
+}
+
+size_t SpectrumCache::KeyHash::operator()(const Key& k) const{
+
+   uint64_t h = k.hash;
+   h = h * 31 + (uint64_t)k.rows;
+   h = h * 31 + (uint64_t)k.cols;
+   h = h * 31 + (uint64_t)k.layout;
+   return (size_t)h;
+}
+
+// 64 bit FNV-1a hash over the bytes of all kernel rows
+/*
+kernel:  filter kernel
+return:  hash value
+*/
+uint64_t SpectrumCache::hashKernel(Mat& kernel){
+
+   uint64_t h = 14695981039346656037ULL;
+   size_t rowBytes = kernel.cols * kernel.elemSize();
+   for (int i = 0; i < kernel.rows; i++){
+      const unsigned char* p = kernel.ptr<unsigned char>(i);
+      for (size_t b = 0; b < rowBytes; b++){
+         h ^= p[b];
+         h *= 1099511628211ULL;
+      }
+   }
+   return h;
+}
+
+// true if both kernels have equal size, type and values
+bool SpectrumCache::sameKernel(Mat& a, Mat& b){
+
+   if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()){
+      return false;
+   }
+   size_t rowBytes = a.cols * a.elemSize();
+   for (int i = 0; i < a.rows; i++){
+      if (memcmp(a.ptr(i), b.ptr(i), rowBytes) != 0){
+         return false;
+      }
+   }
+   return true;
+}
+
+// looks up the spectrum of a kernel, computes and stores it on a miss
+/*
+kernel:   filter kernel
+rows:     rows of the transform
+cols:     columns of the transform
+layout:   SPECTRUM_CCS or SPECTRUM_COMPLEX
+compute:  computes the spectrum
+return:   spectrum, shared with the cache
+*/
+Mat SpectrumCache::get(Mat& kernel, int rows, int cols, int layout, const function<Mat(void)>& compute){
+
+   Key key;
+   key.hash = hashKernel(kernel);
+   key.kRows = kernel.rows;
+   key.kCols = kernel.cols;
+   key.kType = kernel.type();
+   key.rows = rows;
+   key.cols = cols;
+   key.layout = layout;
+
+   {
+      lock_guard<mutex> guard(lock);
+      unordered_map<Key, list<Entry>::iterator, KeyHash>::iterator it = index.find(key);
+      if (it != index.end() && sameKernel(it->second->kernel, kernel)){
+         // move to front (most recently used)
+         entries.splice(entries.begin(), entries, it->second);
+         hits++;
+         return it->second->spectrum;
+      }
+      misses++;
+   }
+
+   // the transform runs without holding the lock, concurrent misses of the same key compute twice
+   Mat spectrum = compute();
+
+   Entry entry;
+   entry.key = key;
+   entry.kernel = kernel.clone();
+   entry.spectrum = spectrum;
+   entry.bytes = spectrum.total() * spectrum.elemSize() + entry.kernel.total() * entry.kernel.elemSize();
+
+   lock_guard<mutex> guard(lock);
+   if (entry.bytes > capacity){
+      return spectrum;
+   }
+   unordered_map<Key, list<Entry>::iterator, KeyHash>::iterator it = index.find(key);
+   if (it != index.end()){
+      // replaced: an other thread stored it in the meantime, or a hash collision
+      memory -= it->second->bytes;
+      entries.erase(it->second);
+      index.erase(it);
+   }
+   entries.push_front(entry);
+   index[key] = entries.begin();
+   memory += entry.bytes;
+   evict();
+
+   return spectrum;
+}
+
+// drops the least recently used entries until the memory cap is met
+void SpectrumCache::evict(void){
+
+   while (memory > capacity && !entries.empty()){
+      Entry& last = entries.back();
+      memory -= last.bytes;
+      index.erase(last.key);
+      entries.pop_back();
+   }
+}
+
+void SpectrumCache::setCapacity(size_t c){
+
+   lock_guard<mutex> guard(lock);
+   capacity = c;
+   evict();
+}
+
+size_t SpectrumCache::getCapacity(void){
+
+   lock_guard<mutex> guard(lock);
+   return capacity;
+}
+
+size_t SpectrumCache::getMemory(void){
+
+   lock_guard<mutex> guard(lock);
+   return memory;
+}
+
+size_t SpectrumCache::getHits(void){
+
+   lock_guard<mutex> guard(lock);
+   return hits;
+}
+
+size_t SpectrumCache::getMisses(void){
+
+   lock_guard<mutex> guard(lock);
+   return misses;
+}
+
+void SpectrumCache::clear(void){
+
+   lock_guard<mutex> guard(lock);
+   entries.clear();
+   index.clear();
+   memory = 0;
+   hits = 0;
+   misses = 0;
+}
@@ -0,0 +1,91 @@
+//============================================================================
+// Name        : SpectrumCache.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : LRU cache of kernel spectra for frequency domain filtering
+//============================================================================
+
+#ifndef COMMON_SPECTRUMCACHE_H
+#define COMMON_SPECTRUMCACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+// layout of a cached spectrum
+enum SpectrumLayout{
+   SPECTRUM_CCS = 0,       // packed real spectrum, dft() without flags
+   SPECTRUM_COMPLEX = 1    // full complex spectrum, dft() with DFT_COMPLEX_OUTPUT
+};
+
+// spectra are looked up by a hash of the kernel content, the size of the transform and the layout.
+// The least recently used spectra are dropped when the memory cap is reached
+class SpectrumCache{
+
+   public:
+      // constructor, capacity in bytes
+      SpectrumCache(size_t capacity);
+      // destructor
+      ~SpectrumCache(void){};
+
+      // cache shared by all processing routines
+      // its capacity in megabytes can be set with the environment variable DIP_SPECTRUM_CACHE_MB
+      static SpectrumCache& instance(void);
+
+      // spectrum of kernel for a rows x cols transform in the given layout
+      // compute() is called on a miss, the returned spectrum must not be changed by the caller
+      Mat get(Mat& kernel, int rows, int cols, int layout, const function<Mat(void)>& compute);
+
+      // memory cap in bytes, smaller caps evict immediately
+      void setCapacity(size_t capacity);
+      size_t getCapacity(void);
+      // bytes of all cached spectra
+      size_t getMemory(void);
+      // lookup statistics
+      size_t getHits(void);
+      size_t getMisses(void);
+      // drops all spectra and resets the statistics
+      void clear(void);
+
+   private:
+      struct Key{
+         uint64_t hash;
+         int kRows, kCols, kType;
+         int rows, cols, layout;
+         bool operator==(const Key& k) const;
+      };
+      struct KeyHash{
+         size_t operator()(const Key& k) const;
+      };
+      struct Entry{
+         Key key;
+         Mat kernel;      // copy of the kernel, hash collisions are detected by comparing it
+         Mat spectrum;
+         size_t bytes;
+      };
+
+      // 64 bit FNV-1a hash of the kernel values
+      static uint64_t hashKernel(Mat& kernel);
+      static bool sameKernel(Mat& a, Mat& b);
+      // drops least recently used entries until memory <= capacity (lock must be held)
+      void evict(void);
+
+      mutex lock;
+      // most recently used entry in front
+      list<Entry> entries;
+      unordered_map<Key, list<Entry>::iterator, KeyHash> index;
+      size_t capacity;
+      size_t memory;
+      size_t hits;
+      size_t misses;
+};
+
+#endif
@@ -0,0 +1,207 @@
+//============================================================================
+// Name        : ThreadPool.cpp
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : 
+//============================================================================
+
+#include "ThreadPool.h"
+
+#include <cstdlib>
+
+// index of the current thread in the pool it works for, -1 outside of any pool
+static thread_local ThreadPool* currentPool = 0;
+static thread_local int currentWorker = -1;
+
+ThreadPool::ThreadPool(int numThreads){
+
+   queued = 0;
+   stopping = false;
+   start(numThreads);
+}
+
+ThreadPool::~ThreadPool(void){
+
+   stop();
+}
+
+// pool shared by all processing routines
+/*
+return:  the pool
+*/
+ThreadPool& ThreadPool::instance(void){
+
+   static ThreadPool pool(getenv("DIP_NUM_THREADS") ? atoi(getenv("DIP_NUM_THREADS")) : 0);
+   return pool;
+}
+
+// changes the number of threads, must not be called while a parallelFor() is running
+/*
+numThreads:  number of threads including the calling thread, <= 0 uses all cores
+*/
+void ThreadPool::setNumThreads(int numThreads){
+
+   stop();
+   start(numThreads);
+}
+
+int ThreadPool::getNumThreads(void){
+
+   return workers.size() + 1;
+}
+
+void ThreadPool::start(int numThreads){
+
+   if (numThreads <= 0){
+      numThreads = thread::hardware_concurrency();
+   }
+   if (numThreads <= 0){
+      numThreads = 1;
+   }
+
+   stopping = false;
+   for (int i = 0; i < numThreads; i++){
+      queues.push_back(new Queue());
+   }
+   for (int i = 0; i < numThreads - 1; i++){
+      workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+   }
+}
+
+void ThreadPool::stop(void){
+
+   {
+      lock_guard<mutex> lock(sleepLock);
+      stopping = true;
+   }
+   wakeUp.notify_all();
+   for (size_t i = 0; i < workers.size(); i++){
+      workers[i].join();
+   }
+   workers.clear();
+   for (size_t i = 0; i < queues.size(); i++){
+      delete queues[i];
+   }
+   queues.clear();
+}
+
+// calls body(0) ... body(n-1), distributed over all threads
+/*
+n:     number of calls
+body:  function to call, each index is processed exactly once unless a call throws
+*/
+void ThreadPool::parallelFor(int n, const function<void(int)>& body){
+
+   if (n <= 0){
+      return;
+   }
+   if ( (workers.size() == 0) || (n == 1) ){
+      for (int i = 0; i < n; i++){
+         body(i);
+      }
+      return;
+   }
+
+   int self = (currentPool == this) ? currentWorker : queues.size() - 1;
+
+   Batch batch;
+   batch.body = &body;
+   batch.pending = n;
+   batch.failed = false;
+
+   // contiguous chunks per queue keep neighbouring tiles on the same thread,
+   // idle threads steal the remaining ones from the back
+   int numQueues = queues.size();
+   for (int q = 0; q < numQueues; q++){
+      int first = (long long)q * n / numQueues;
+      int last = (long long)(q + 1) * n / numQueues;
+      if (first == last){
+         continue;
+      }
+      Queue* queue = queues[(self + q) % numQueues];
+      lock_guard<mutex> lock(queue->lock);
+      for (int i = first; i < last; i++){
+         Task task = {&batch, i};
+         queue->tasks.push_back(task);
+      }
+   }
+   queued += n;
+   {
+      lock_guard<mutex> lock(sleepLock);
+   }
+   wakeUp.notify_all();
+
+   // help until the whole batch is done
+   while (batch.pending > 0){
+      if (!runTask(self)){
+         this_thread::yield();
+      }
+   }
+   if (batch.failed){
+      rethrow_exception(batch.error);
+   }
+}
+
+// executes one task, taken from the own queue or stolen from another one
+/*
+self:    queue index of the calling thread
+return:  false if all queues were empty
+*/
+bool ThreadPool::runTask(int self){
+
+   Task task;
+   bool found = false;
+   int numQueues = queues.size();
+
+   for (int q = 0; (q < numQueues) && !found; q++){
+      Queue* queue = queues[(self + q) % numQueues];
+      lock_guard<mutex> lock(queue->lock);
+      if (queue->tasks.empty()){
+         continue;
+      }
+      if (q == 0){
+         task = queue->tasks.front();
+         queue->tasks.pop_front();
+      }else{
+         task = queue->tasks.back();
+         queue->tasks.pop_back();
+      }
+      found = true;
+   }
+   if (!found){
+      return false;
+   }
+
+   queued--;
+   // an exception must not leave a worker thread (std::terminate), it is handed to parallelFor()
+   if (!task.batch->failed){
+      try{
+         (*task.batch->body)(task.index);
+      }catch (...){
+         bool expected = false;
+         if (task.batch->failed.compare_exchange_strong(expected, true)){
+            task.batch->error = current_exception();
+         }
+      }
+   }
+   task.batch->pending--;
+   return true;
+}
+
+void ThreadPool::workerLoop(int id){
+
+   currentPool = this;
+   currentWorker = id;
+
+   while (true){
+      if (runTask(id)){
+         continue;
+      }
+      unique_lock<mutex> lock(sleepLock);
+      wakeUp.wait(lock, [this]{ return stopping || (queued > 0); });
+      if (stopping){
+         break;
+      }
+   }
+}
@@ -0,0 +1,77 @@
+//============================================================================
+// Name        : ThreadPool.h
+// Author      : -
+// Version     : 2.0
+// Copyright   : -
+// Description : work-stealing thread pool shared by all assignments
+//============================================================================
+
+#ifndef COMMON_THREADPOOL_H
+#define COMMON_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class ThreadPool{
+
+   public:
+      // constructor, numThreads <= 0 uses all cores
+      ThreadPool(int numThreads = 0);
+      // destructor
+      ~ThreadPool(void);
+
+      // pool shared by all processing routines
+      // its size can be set with the environment variable DIP_NUM_THREADS
+      static ThreadPool& instance(void);
+
+      // number of threads working on a parallelFor() (including the calling thread)
+      void setNumThreads(int numThreads);
+      int getNumThreads(void);
+
+      // calls body(0) ... body(n-1), distributed over all threads
+      // returns when all calls are done; may be called from within a body
+      // an exception thrown by a body is rethrown here on the calling thread (the first one if
+      // several bodies throw), the calls not yet started are skipped
+      void parallelFor(int n, const function<void(int)>& body);
+
+   private:
+      struct Batch{
+         const function<void(int)>* body;
+         atomic<int> pending;
+         // first exception thrown by a body, set at most once
+         atomic<bool> failed;
+         exception_ptr error;
+      };
+      struct Task{
+         Batch* batch;
+         int index;
+      };
+      // one task queue per thread, the owner pops in front, thieves steal from the back
+      struct Queue{
+         mutex lock;
+         deque<Task> tasks;
+      };
+
+      void start(int numThreads);
+      void stop(void);
+      void workerLoop(int id);
+      bool runTask(int self);
+
+      vector<thread> workers;
+      // queues[i] belongs to worker i, the last one to threads outside of the pool
+      vector<Queue*> queues;
+      mutex sleepLock;
+      condition_variable wakeUp;
+      atomic<int> queued;
+      bool stopping;
+};
+
+#endif
@@ -8,40 +8,148 @@
 
 #include "Dip3.h"
 
+#include "../Common/ConvEngine.h"
+#include "../Common/GaussianBank.h"
+#include "../Common/IntegralImage.h"
+#include "../Common/RecursiveGaussian.h"
+#include "../Common/Spectral.h"
+#include "../Common/ThreadPool.h"
+
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+// images with more pixels are convolved in tiles of FFT_TILE_SIZE x FFT_TILE_SIZE (overlap-save)
+static const size_t FFT_TILE_MIN_PIXELS = 4096 * 4096;
+static const int FFT_TILE_SIZE = 1024;
+
+// cost model of the smoothing types SMOOTH_TYPES: nanoseconds per work unit and thread (see smoothUnits())
+// measured on the first automatic choice for the current number of threads, or loaded
+// from the profile file named by the environment variable DIP_COST_PROFILE
+static const int NUM_SMOOTH_TYPES = 5;
+static const int SMOOTH_TYPES[NUM_SMOOTH_TYPES] = {0, 1, 2, 3, 6};
+static const char* SMOOTH_NAMES[NUM_SMOOTH_TYPES] = {"spatial", "frequency", "seperable", "sat", "recursive"};
+static double smoothNsPerUnit[NUM_SMOOTH_TYPES];
+static int smoothCostThreads = 0;
+static mutex smoothCostLock;
+
+// pixels per task of the parallel filters, smaller images keep fewer threads busy
+static const double PIXELS_PER_TASK = 64 * 256;
+
+// calibration image size and kernel size per type (sat and recursive have to approximate the kernel)
+static const int CALIB_SIZE = 256;
+static const int CALIB_KERNEL[NUM_SMOOTH_TYPES] = {7, 7, 15, 21, 21};
+
+// smallest standard deviation the three boxes of satFilter() (widths of at least five) and the
+// recursive filter approximate within 2% of the grey value range
+static const double APPROX_MIN_SIGMA = 3;
+
+// index of smoothing type in the cost model
+/*
+type     smoothing type
+return   index into SMOOTH_TYPES, -1 if the type is not modelled
+*/
+static int smoothIndex(int type){
+
+   for (int t = 0; t < NUM_SMOOTH_TYPES; t++){
+      if (SMOOTH_TYPES[t] == type){
+         return t;
+      }
+   }
+   return -1;
+}
+
+// work units of smoothing type, the time of one thread is about proportional to them
+// the frequency domain works on the image padded to fast DFT sizes, large images tile by tile
+/*
+type     smoothing type
+rows     image rows
+cols     image columns
+size     kernel size
+tasks    returns the number of tasks that can run in parallel
+return   work units
+*/
+static double smoothUnits(int type, int rows, int cols, int size, int& tasks){
+
+   double pixels = (double)rows * cols;
+   tasks = max(1, (int)(pixels / PIXELS_PER_TASK));
+
+   if (type == 1){
+      int tileRows = rows, tileCols = cols, tilesY = 1, tilesX = 1;
+      if ((size_t)pixels > FFT_TILE_MIN_PIXELS && (rows > FFT_TILE_SIZE || cols > FFT_TILE_SIZE)){
+         tileRows = min(FFT_TILE_SIZE, rows);
+         tileCols = min(FFT_TILE_SIZE, cols);
+      }
+      double fftRows = getOptimalDFTSize(tileRows + size - 1);
+      double fftCols = getOptimalDFTSize(tileCols + size - 1);
+      if (tileRows < rows || tileCols < cols){
+         tilesY = (rows + (int)fftRows - size) / ((int)fftRows - size + 1);
+         tilesX = (cols + (int)fftCols - size) / ((int)fftCols - size + 1);
+      }
+      // the whole image is one transform, tiles are transformed in parallel
+      tasks = tilesY * tilesX;
+      double fftPixels = fftRows * fftCols;
+      return tasks * fftPixels * log2(max(fftPixels, 2.));
+   }
+
+   double padded = (double)(rows + size - 1) * (cols + size - 1);
+   switch(type){
+      case 0: return pixels * size * size;          // full 2D kernel per pixel
+      case 2: return pixels * (2 * size + 2);        // two 1D passes
+      case 3: return padded;                         // tables of the padded image
+      default: return pixels;                        // constant per pixel
+   }
+}
+
 // Generates a gaussian filter kernel of given size
+// the kernel comes from the shared bank, it is computed once per (size, sigma)
 /*
 kSize:     kernel size (used to calculate standard deviation)
 return:    the generated filter kernel
 */
 Mat Dip3::createGaussianKernel(int kSize){
 
-  //create symmetric kernel
-	Mat Kernel = Mat(kSize, kSize, CV_32FC1);
-	double sigma = kSize/kSize;
-
-	double mean = kSize/2;
-
-	double sum = 0.0; // Accumulate kernel values
-	for (int x = 0; x < kSize; ++x)
-	    for (int y = 0; y < kSize; ++y) {
-	        Kernel.at<float>(x,y)= exp( -0.5 * (pow((x-mean)/sigma, 2.0) + pow((y-mean)/sigma,2.0)) )
-	                         / (2 * M_PI * sigma * sigma);
+   return GaussianBank::instance().kernel2D(kSize, gaussianSigma(kSize));
+}
 
-	        // Accumulate kernel values
-	        sum += Kernel.at<float>(x,y);
-	    }
+// Generates the 1D factor of the gaussian filter kernel
+// same standard deviation and center as createGaussianKernel(), so that
+// createGaussianKernel(kSize) == createGaussianKernel1D(kSize)^T * createGaussianKernel1D(kSize)
+/*
+kSize:     kernel size (used to calculate standard deviation)
+return:    the generated 1 x kSize filter kernel
+*/
+Mat Dip3::createGaussianKernel1D(int kSize){
 
-	// Normalize the kernel
-	for (int x = 0; x < kSize; ++x)
-	    for (int y = 0; y < kSize; ++y)
-	    	Kernel.at<float>(x,y) /= sum;
+   return GaussianBank::instance().kernel1D(kSize, gaussianSigma(kSize));
+}
 
-	
+// Checks whether the constant cost filters approximate the gaussian kernel
+// they do not cut the gaussian at the kernel border, so it has to cover +-3 standard deviations
+/*
+kSize:     kernel size
+return:    true if satFilter() and recursiveFilter() are within 2% of the grey value range of the kernel
+*/
+bool Dip3::approximatesGaussian(int kSize){
 
-  return Kernel;
+   double s = gaussianSigma(kSize);
+   return (s >= APPROX_MIN_SIGMA) && (s <= max(1.0, (kSize - 1) / 6.));
 }
 
+// Standard deviation of the gaussian kernels
+// shared by all smoothing types, so that they smooth the same way
+// by default the kernel covers +-3 standard deviations, but at least one pixel
+/*
+kSize:     kernel size
+return:    standard deviation set by setSigma(), max(1, (kSize-1)/6) by default
+*/
+double Dip3::gaussianSigma(int kSize){
 
+   return (sigma > 0) ? sigma : max(1.0, (kSize - 1) / 6.);
+}
 
 // Performes a circular shift in (dx,dy) direction
 /*
@@ -52,84 +160,25 @@ return   circular shifted matrix
 */
 Mat Dip3::circShift(Mat& in, int dx, int dy){
 
-	Mat res = in.clone();
-
-	int yy, xx;
-
-	for (int y = 0; y < res.rows; y++)
-	{
-		//shift in y direction
-		yy = (y + dy) % res.rows;
-
-		//row border
-		if(yy<0)
-			yy = yy + res.rows;
-
-		for (int x = 0; x < res.cols; x++)
-		{
-			//shift in x direction
-			xx = (x + dx) % res.cols;
-
-			//col border
-			if(xx < 0)
-				xx = xx + res.cols;
-
-			//shift values
-			res.at<float>(yy*res.cols + xx) = in.at<float>(y * res.cols + x);
-		}
-
-	}
-
-
-   // TO DO !!!
-
-   return res;
+   // whole row blocks are copied instead of single elements
+   return Spectral::circShift(in, dx, dy);
 }
 
 //Performes a convolution by multiplication in frequency domain
+// the image is padded (border policy see setBorderType()) to a fast DFT size and filtered
+// on packed real spectra; the kernel spectrum is cached over calls
 /*
 in       input image
 kernel   filter kernel
 return   output image
 */
 Mat Dip3::frequencyConvolution(Mat& in, Mat& kernel){
-	// copy of the kernel in a matrix with in size
-	  int in_row = in.rows;
-	  int in_col = in.cols;
-
-	  int k_row = kernel.rows;
-	  int k_col = kernel.cols;
-
-	  Mat new_kernel =  Mat::zeros(in_row, in_col, CV_32FC1);
-
-
-	  for (int i = 0 ; i < k_row ; i ++)
-	  {
-	    for (int j = 0 ; j < k_col ; j ++)
-	    {
-	      new_kernel.at<float>(i,j) = kernel.at<float>(i,j);
-	    }
-	  }
-
-	  Mat shift_kernel = circShift(new_kernel, -k_row/2, -k_col/2);
-
-	  //Forward transform:
-	  Mat F_kernel;
-	  dft(shift_kernel, F_kernel, 0 );
 
-	  Mat F_input;
-	  dft(in, F_input, 0 );
+	// large images are convolved tile by tile to bound the memory
+	int tileSize = (in.total() > FFT_TILE_MIN_PIXELS) ? FFT_TILE_SIZE : 0;
+	Spectral spectral(borderType, tileSize);
 
-	  //Spectrum multiplication
-	  Mat Convol;
-	  mulSpectrums(F_input, F_kernel, Convol, 0 );
-
-	  //Inverse transform
-	  Mat output;
-	  dft(Convol, output, DFT_INVERSE + DFT_SCALE);
-
-
-	   return output;
+	return spectral.convolve(in, kernel);
 }
 
 // Performs UnSharp Masking to enhance fine image structures
@@ -137,163 +186,120 @@ Mat Dip3::frequencyConvolution(Mat& in, Mat& kernel){
 in       input image
 type     integer defining how convolution for smoothing operation is done
          0 <==> spatial domain; 1 <==> frequency domain; 2 <==> seperable filter; 3 <==> integral image
-size     size of used smoothing kernel
+         4 <==> automatic choice; 5 <==> fused single pass (seperable filter); 6 <==> recursive filter
+size     size of used smoothing kernel, its standard deviation is max(1, (size-1)/6) unless set by setSigma()
+         (types 3 and 6 approximate it from a standard deviation of 3 on, smaller ones are filtered exactly)
 thresh   minimal intensity difference to perform operation
 scale    scaling of edge enhancement
 return   enhanced image
 */
 Mat Dip3::usm(Mat& in, int type, int size, double thresh, double scale){
 
-   // some temporary images 
-   Mat tmp(in.rows, in.cols, CV_32FC1);
-   Mat diff(in.rows, in.cols, CV_32FC1);
-   Mat finalImage(in.rows, in.cols, CV_32FC1);
-   
+   // smoothing, difference, threshold and scaled addition per row in registers,
+   // the only image sized buffer is the result
+   if (type == 5){
+      Mat kernel = createGaussianKernel1D(size);
+      ConvEngine engine;
+      return engine.unsharpMask(in, kernel, kernel, thresh, scale);
+   }
 
    // calculate edge enhancement
 
    // 1: smooth original image
    //    save result in tmp for subsequent usage
+   Mat tmp;
    switch(type){
       case 0:
-         tmp = mySmooth(in, size, 0);
-         break;
       case 1:
-         tmp = mySmooth(in, size, 1);
+      case 2:
+      case 3:
+      case 4:
+      case 6:
+         tmp = mySmooth(in, size, type);
          break;
-      case 2: 
-	tmp = mySmooth(in, size, 2);
-        break;
-      case 3: 
-	tmp = mySmooth(in, size, 3);
-        break;
       default:
          GaussianBlur(in, tmp, Size(floor(size/2)*2+1, floor(size/2)*2+1), size/5., size/5.);
    }
 
-   Mat E(in.size(), in.type());
-   diff.convertTo(E, CV_32FC1);
-
-   Mat C( in.size(), in.type() );
-   tmp.convertTo(C, CV_32FC1);
-
-   subtract(in, tmp, diff);
-
-
- 	//Mat semiFinal = in + diff;
-    Mat F(in.size(), in.type());
-    finalImage.convertTo(F, CV_32FC1);
-
-
-    threshold(diff, diff, thresh, 255, THRESH_TOZERO);
+   // 2: difference of original and smoothed image, small differences are dropped
+   //    computed in place of tmp
+   subtract(in, tmp, tmp);
+   threshold(tmp, tmp, thresh, 255, THRESH_TOZERO);
 
-    add(in,(scale*diff),finalImage);
-
-
-  cout << "num pixels: " << in.total() << endl;
-
-      //return finalImage;
-    return finalImage;
+   // 3: add scaled differences
+   scaleAdd(tmp, scale, in, tmp);
 
+   return tmp;
 }
 
 // convolution in spatial domain
+// the work is done by the shared tiled/multithreaded engine (see Common/ConvEngine)
 /*
 src:    input image
 kernel:  filter kernel
 return:  convolution result
 */
 Mat Dip3::spatialConvolution(Mat& src, Mat& kernel){
-	int kSize = kernel.rows;
-		// we assume kernel is a square matrix
-		int srcRow = src.rows;
-		int srcCol = src.cols;
-
-	  Mat output =  Mat::zeros(srcRow,srcCol, CV_32FC1);
-
-
-	  // flip the kernel
 
-	  Mat kernel_flip =  Mat::zeros(kSize,kSize, CV_32FC1);
+	ConvEngine engine;
 
-	  for (int k = 0 ; k < kSize ; k ++)
-	  {
-	    for (int l = 0 ; l < kSize ; l ++)
-	    {
-	      kernel_flip.at<float>(k, l) = kernel.at<float>(kSize - 1 - k, kSize - 1 - l);
-	    }
-	  }
-
-
-
-		for (int i = 0; i < srcRow; i++)
-		{
-			for (int j = 0; j < srcCol; j++)
-			{
-	      float res = 0; //  will contain the sum of all the convoluted terms.
-
-				for (int k = 0; k < kSize; k++)
-				{
-					int k_src = i - (kSize - 1) / 2 + k;
-					if (k_src < 0)
-					{
-						k_src = 0;
-					}
-					else if (k_src >= srcRow)
-					{
-						k_src = srcRow - 1;
-					}
-					for (int l = 0; l < kSize; l++)
-					{
-						int l_src = j + l - (kSize - 1) / 2;
-						if (l_src < 0)
-						{
-							l_src = 0;
-						}
-						else if (l_src >= srcCol)
-						{
-							l_src = srcCol - 1;
-						}
-
-						res = res + src.at<float>(k_src,l_src) * kernel_flip.at<float>(k, l);
-					}
-				}
+	return engine.convolve(src, kernel);
+}
 
-				output.at<float>(i,j) = res;
+// convolution in spatial domain by seperable filters
+// the gaussian is applied as a vertical and a horizontal 1D pass --> O(size) per pixel
+/*
+src:    input image
+size     size of filter kernel
+return:  convolution result
+*/
+Mat Dip3::seperableFilter(Mat& src, int size){
 
+   Mat kernel = createGaussianKernel1D(size);
 
-			}
+   ConvEngine engine;
 
-		}
+   return engine.convolveSeparable(src, kernel, kernel);
 
-		return output;
 }
 
-// convolution in spatial domain by seperable filters
+// convolution in spatial domain by integral images
+// the gaussian is approximated by three box filters, each costs four table lookups per pixel
+// kernels the boxes do not approximate (see approximatesGaussian()) are filtered exactly by seperableFilter()
 /*
 src:    input image
 size     size of filter kernel
 return:  convolution result
 */
-Mat Dip3::seperableFilter(Mat& src, int size){
+Mat Dip3::satFilter(Mat& src, int size){
 
-   // optional
+   if (!approximatesGaussian(size)){
+      return seperableFilter(src, size);
+   }
+
+   IntegralImage sat;
 
-   return src;
+   return sat.gaussianFilter(src, gaussianSigma(size), 3);
 
 }
 
-// convolution in spatial domain by integral images
+// convolution by a recursive (IIR) approximation of the gaussian
+// a fixed number of operations per pixel whatever the kernel size
+// kernels it does not approximate (see approximatesGaussian()) are filtered exactly by seperableFilter()
 /*
 src:    input image
 size     size of filter kernel
 return:  convolution result
 */
-Mat Dip3::satFilter(Mat& src, int size){
+Mat Dip3::recursiveFilter(Mat& src, int size){
+
+   if (!approximatesGaussian(size)){
+      return seperableFilter(src, size);
+   }
 
-   // optional
+   RecursiveGaussian iir;
 
-   return src;
+   return iir.filter(src, gaussianSigma(size));
 
 }
 
@@ -323,29 +329,178 @@ Mat Dip3::run(Mat& in, int smoothType, int size, double thresh, double scale){
 in       input image
 size     size of filter kernel
 type     how is smoothing performed?
+         0 <==> spatial domain; 1 <==> frequency domain; 2 <==> seperable filter; 3 <==> integral image
+         4 <==> automatic choice of the fastest type matching the gaussian; 6 <==> recursive filter
+         (types 3 and 6 approximate the gaussian from a standard deviation of 3 on, see approximatesGaussian())
 return   smoothed image
 */
 Mat Dip3::mySmooth(Mat& in, int size, int type){
 
+   if (type == 4){
+      type = autoSmoothType(in, size);
+   }
+
+   // perform convoltion, only the 2D convolutions need the 2D filter kernel
+   switch(type){
+     case 2: return seperableFilter(in, size);	// seperable filter
+     case 3: return satFilter(in, size);		// integral image
+     case 6: return recursiveFilter(in, size);	// recursive filter
+   }
+
    // create filter kernel
    Mat kernel = createGaussianKernel(size);
- 
-   // perform convoltion
+
    switch(type){
      case 0: return spatialConvolution(in, kernel);	// 2D spatial convolution
      case 1: return frequencyConvolution(in, kernel);	// 2D convolution via multiplication in frequency domain
-     case 2: return seperableFilter(in, size);	// seperable filter
-     case 3: return satFilter(in, size);		// integral image
      default: return frequencyConvolution(in, kernel);
    }
 }
 
+// Chooses the smoothing type automatically
+// the candidates are compared by their estimated time, the decision is logged.
+// The exact convolutions are always candidates, sat and recursive filter only if they
+// approximate the kernel (see approximatesGaussian())
+/*
+in       input image
+size     size of filter kernel
+return   smoothing type
+*/
+int Dip3::autoSmoothType(Mat& in, int size){
+
+   calibrateSmoothCost();
+
+   int best = SMOOTH_TYPES[0];
+   double bestCost = DBL_MAX;
+   ostringstream estimates;
+   for (int t = 0; t < NUM_SMOOTH_TYPES; t++){
+      int type = SMOOTH_TYPES[t];
+      if ( (type == 3 || type == 6) && !approximatesGaussian(size) ){
+         continue;
+      }
+      double cost = smoothCost(type, in.rows, in.cols, size);
+      estimates << (t > 0 ? ", " : "") << SMOOTH_NAMES[t] << " " << cost << " ms";
+      if (cost < bestCost){
+         bestCost = cost;
+         best = type;
+      }
+   }
+
+   clog << "Dip3::mySmooth(): auto selects " << SMOOTH_NAMES[smoothIndex(best)] << " for " << in.cols << "x" << in.rows
+        << ", kernel size " << size << " (" << estimates.str() << ")" << endl;
+
+   return best;
+}
+
+// Estimated time of a smoothing type
+// the work units are shared by the threads, but not by more than there are tasks
+/*
+type     smoothing type (0, 1, 2, 3 or 6)
+rows     image rows
+cols     image columns
+size     kernel size
+return   estimated time in milliseconds
+*/
+double Dip3::smoothCost(int type, int rows, int cols, int size){
+
+   int tasks;
+   double units = smoothUnits(type, rows, cols, size, tasks);
+   int threads = min(tasks, ThreadPool::instance().getNumThreads());
+
+   lock_guard<mutex> lock(smoothCostLock);
+   return smoothNsPerUnit[smoothIndex(type)] * units / threads * 1e-6;
+}
+
+// Calibrates the cost model
+// every type smooths a test image, the best of two runs gives the time per work unit and thread.
+// If DIP_COST_PROFILE names a file, a profile measured with the same number of threads
+// is loaded from it instead, and new measurements are written to it
+void Dip3::calibrateSmoothCost(void){
+
+   lock_guard<mutex> lock(smoothCostLock);
+
+   int threads = ThreadPool::instance().getNumThreads();
+   if (smoothCostThreads == threads){
+      return;
+   }
+
+   const char* profile = getenv("DIP_COST_PROFILE");
+   if (profile){
+      // profile: number of threads followed by the ns per work unit and thread of every type in SMOOTH_TYPES
+      ifstream cache(profile);
+      int cachedThreads = 0;
+      double values[NUM_SMOOTH_TYPES];
+      bool ok = bool(cache >> cachedThreads) && (cachedThreads == threads);
+      for (int t = 0; ok && t < NUM_SMOOTH_TYPES; t++){
+         ok = bool(cache >> values[t]) && (values[t] > 0);
+      }
+      if (ok){
+         for (int t = 0; t < NUM_SMOOTH_TYPES; t++){
+            smoothNsPerUnit[t] = values[t];
+         }
+         smoothCostThreads = threads;
+         clog << "Dip3::mySmooth(): cost model loaded from " << profile << endl;
+         return;
+      }
+   }
+
+   // the kernels of the default standard deviation, which sat and recursive filter approximate
+   double userSigma = sigma;
+   sigma = 0;
+   Mat img = patternImage(CALIB_SIZE, CALIB_SIZE);
+   for (int t = 0; t < NUM_SMOOTH_TYPES; t++){
+      double best = DBL_MAX;
+      for (int r = 0; r < 2; r++){
+         int64 start = getTickCount();
+         mySmooth(img, CALIB_KERNEL[t], SMOOTH_TYPES[t]);
+         best = min(best, (getTickCount() - start) / getTickFrequency());
+      }
+      int tasks;
+      double units = smoothUnits(SMOOTH_TYPES[t], img.rows, img.cols, CALIB_KERNEL[t], tasks);
+      smoothNsPerUnit[t] = max(best, 1e-9) * 1e9 * min(tasks, threads) / units;
+   }
+   sigma = userSigma;
+   smoothCostThreads = threads;
+   clog << "Dip3::mySmooth(): cost model calibrated for " << threads << " threads" << endl;
+
+   if (profile){
+      ofstream cache(profile);
+      cache << threads;
+      for (int t = 0; t < NUM_SMOOTH_TYPES; t++){
+         cache << " " << smoothNsPerUnit[t];
+      }
+      cache << endl;
+   }
+}
+
+// textured test image, every row and column differs
+/*
+rows     :  number of rows
+cols     :  number of columns
+return   :  image with values (7*x*x + 13*y) mod 256
+*/
+Mat Dip3::patternImage(int rows, int cols){
+
+   Mat img(rows, cols, CV_32FC1);
+   for(int y=0; y<rows; y++){
+      for(int x=0; x<cols; x++){
+         img.at<float>(y,x) = (7*x*x + 13*y) % 256;
+      }
+   }
+   return img;
+}
+
 // function calls some basic testing routines to test individual functions for correctness
 void Dip3::test(void){
 
    test_createGaussianKernel();
    test_circShift();
    test_frequencyConvolution();
+   test_seperableFilter();
+   test_satFilter();
+   test_recursiveFilter();
+   test_autoSmoothType();
+   test_usm();
    cout << "Press enter to continue"  << endl;
    cin.get();
 
@@ -363,6 +518,57 @@ void Dip3::test_createGaussianKernel(void){
       cout << "ERROR: Dip3::createGaussianKernel(): Seems like kernel is not centered!" << endl;
       return;
    }
+
+   // the compile-time tables and the 2D kernels have to agree with the gaussian formula
+   for(int size=3; size<=9; size++){
+      for(double s=0.5; s<=2; s+=0.5){
+         Mat k1 = GaussianBank::instance().kernel1D(size, s);
+         Mat k2 = GaussianBank::instance().kernel2D(size, s);
+         double total = 0;
+         for(int x=0; x<size; x++){
+            total += exp(-0.5*(x-size/2)*(x-size/2)/(s*s));
+         }
+         for(int y=0; y<size; y++){
+            double gy = exp(-0.5*(y-size/2)*(y-size/2)/(s*s)) / total;
+            if (abs(k1.at<float>(0,y) - gy) > 1e-6){
+               cout << "ERROR: Dip3::createGaussianKernel(): 1D kernel contains wrong values!" << endl;
+               return;
+            }
+            for(int x=0; x<size; x++){
+               double gx = exp(-0.5*(x-size/2)*(x-size/2)/(s*s)) / total;
+               if (abs(k2.at<float>(y,x) - gx*gy) > 1e-6){
+                  cout << "ERROR: Dip3::createGaussianKernel(): 2D kernel contains wrong values!" << endl;
+                  return;
+               }
+            }
+         }
+      }
+   }
+
+   // returned kernels are copies, changing one keeps the bank intact
+   Mat changed = createGaussianKernel(5);
+   changed.setTo(0);
+   if ( abs(sum(createGaussianKernel(5)).val[0] - 1) > 0.0001){
+      cout << "ERROR: Dip3::createGaussianKernel(): Changing a kernel changes the cached one!" << endl;
+      return;
+   }
+
+   // a full bank drops the least recently used kernels
+   GaussianBank bank(3 * 9 * sizeof(float));
+   bank.kernel1D(9, 1);
+   bank.kernel1D(9, 2);
+   bank.kernel1D(9, 1);
+   bank.kernel1D(9, 3);
+   bank.kernel1D(9, 4);
+   if ( (bank.getCount() != 3) || (bank.getMemory() > bank.getCapacity()) ){
+      cout << "ERROR: Dip3::createGaussianKernel(): Kernel bank exceeds its memory cap!" << endl;
+      return;
+   }
+   bank.setCapacity(9 * sizeof(float));
+   if ( (bank.getCount() != 1) || (abs(sum(bank.kernel1D(9, 2)).val[0] - 1) > 0.0001) || (bank.getCount() != 1) ){
+      cout << "ERROR: Dip3::createGaussianKernel(): Kernel bank exceeds its memory cap!" << endl;
+      return;
+   }
    cout << "Message: Dip3::createGaussianKernel() seems to be correct" << endl;
 }
 
@@ -417,3 +623,184 @@ void Dip3::test_frequencyConvolution(void){
    }
    cout << "Message: Dip3::frequencyConvolution() seems to be correct" << endl;
 }
+
+void Dip3::test_seperableFilter(void){
+
+   Mat input = patternImage(20, 23);
+
+   for(int size=3; size<=6; size++){
+      Mat kernel = createGaussianKernel(size);
+      Mat ref = spatialConvolution(input, kernel);
+      Mat output = seperableFilter(input, size);
+      if (norm(output, ref, NORM_INF) > 0.001){
+         cout << "ERROR: Dip3::seperableFilter(): Result differs from 2D convolution!" << endl;
+         return;
+      }
+   }
+   cout << "Message: Dip3::seperableFilter() seems to be correct" << endl;
+}
+
+void Dip3::test_satFilter(void){
+
+   // box filters keep constant images and linear ramps (away from the border)
+   Mat input = Mat::zeros(40,37, CV_32FC1);
+   for(int y=0; y<input.rows; y++){
+      for(int x=0; x<input.cols; x++){
+         input.at<float>(y,x) = 2*x + 3*y + 1;
+      }
+   }
+   Mat output = satFilter(input, 25);
+   for(int y=12; y<input.rows-12; y++){
+      for(int x=12; x<input.cols-12; x++){
+         if (abs(output.at<float>(y,x) - input.at<float>(y,x)) > 0.001){
+            cout << "ERROR: Dip3::satFilter(): Result contains wrong values!" << endl;
+            return;
+         }
+      }
+   }
+
+   // box filter of the summed-area table has to be equal to the spatial box filter
+   IntegralImage sat;
+   input = patternImage(input.rows, input.cols);
+   for(int size=2; size<=7; size++){
+      Mat kernel = Mat(size,size, CV_32FC1, 1./(size*size));
+      if (norm(sat.boxFilter(input, size), spatialConvolution(input, kernel), NORM_INF) > 0.001){
+         cout << "ERROR: Dip3::satFilter(): Box filter differs from 2D convolution!" << endl;
+         return;
+      }
+   }
+
+   // the boxes have to approximate the gaussian of the kernel size, small kernels are exact
+   input = patternImage(90, 97);
+   for(int size=9; size<=41; size+=8){
+      Mat ref = seperableFilter(input, size);
+      double tolerance = approximatesGaussian(size) ? 5 : 0.001;
+      if (norm(satFilter(input, size), ref, NORM_INF) > tolerance){
+         cout << "ERROR: Dip3::satFilter(): Result differs from the gaussian filter!" << endl;
+         return;
+      }
+   }
+   cout << "Message: Dip3::satFilter() seems to be correct" << endl;
+}
+
+void Dip3::test_usm(void){
+
+   Mat input = patternImage(70, 83);
+
+   // the fused single pass has to give the result of the separate passes
+   for(int size=3; size<=9; size+=2){
+      Mat ref = usm(input, 2, size, 5, 1.5);
+      Mat output = usm(input, 5, size, 5, 1.5);
+      if (norm(output, ref, NORM_INF) > 0.001){
+         cout << "ERROR: Dip3::usm(): Fused unsharp masking differs from the separate passes!" << endl;
+         return;
+      }
+   }
+   cout << "Message: Dip3::usm() seems to be correct" << endl;
+}
+
+void Dip3::test_recursiveFilter(void){
+
+   // constant images are kept
+   Mat input(30, 41, CV_32FC1, Scalar(100));
+   Mat output = recursiveFilter(input, 25);
+   if (norm(output - input, NORM_INF) > 0.001){
+      cout << "ERROR: Dip3::recursiveFilter(): Constant image is changed!" << endl;
+      return;
+   }
+
+   // borders behave as if the image was continued by its replicated border pixels
+   input = patternImage(input.rows, input.cols);
+   int border = 40;
+   Mat padded;
+   copyMakeBorder(input, padded, border, border, border, border, BORDER_REPLICATE);
+   output = recursiveFilter(input, 25);
+   Mat ref = recursiveFilter(padded, 25);
+   for(int y=0; y<input.rows; y++){
+      for(int x=0; x<input.cols; x++){
+         if (abs(output.at<float>(y,x) - ref.at<float>(y+border,x+border)) > 0.01){
+            cout << "ERROR: Dip3::recursiveFilter(): Result at the borders is wrong!" << endl;
+            return;
+         }
+      }
+   }
+
+   // the recursion has to approximate the gaussian of the kernel size, small kernels are exact
+   input = patternImage(90, 97);
+   for(int size=9; size<=57; size+=12){
+      ref = seperableFilter(input, size);
+      double tolerance = approximatesGaussian(size) ? 5 : 0.001;
+      if (norm(recursiveFilter(input, size), ref, NORM_INF) > tolerance){
+         cout << "ERROR: Dip3::recursiveFilter(): Result differs from the gaussian filter!" << endl;
+         return;
+      }
+   }
+   cout << "Message: Dip3::recursiveFilter() seems to be correct" << endl;
+}
+
+void Dip3::test_autoSmoothType(void){
+
+   // a profile in DIP_COST_PROFILE replaces the calibration, every type is made the cheapest once
+   const char* previous = getenv("DIP_COST_PROFILE");
+   string saved = previous ? previous : "";
+   string profile = "dip3_cost_profile_test.txt";
+   setenv("DIP_COST_PROFILE", profile.c_str(), 1);
+
+   Mat input = patternImage(70, 83);
+   int threads = ThreadPool::instance().getNumThreads();
+   string error;
+   for(int t=0; t<NUM_SMOOTH_TYPES && error.empty(); t++){
+      ofstream file(profile.c_str());
+      file << threads;
+      for(int u=0; u<NUM_SMOOTH_TYPES; u++){
+         file << " " << ((u == t) ? 1e-6 : 1e3);
+      }
+      file << endl;
+      file.close();
+      smoothCostThreads = 0;
+
+      // kernel size 9 is only filtered exactly, 25 is approximated by sat and recursive filter
+      for(int size=9; size<=25 && error.empty(); size+=16){
+         int type = autoSmoothType(input, size);
+         bool candidate = approximatesGaussian(size) || (SMOOTH_TYPES[t] != 3 && SMOOTH_TYPES[t] != 6);
+         if ( (candidate && type != SMOOTH_TYPES[t]) || (!approximatesGaussian(size) && (type == 3 || type == 6)) ){
+            error = "Cheapest smoothing type is not selected!";
+            break;
+         }
+         double tolerance = (type == 3 || type == 6) ? 5 : 0.01;
+         Mat ref = seperableFilter(input, size);
+         if (norm(mySmooth(input, size, 4), ref, NORM_INF) > tolerance){
+            error = "Selected smoothing type differs from the gaussian filter!";
+         }
+      }
+   }
+
+   // without a valid profile the cost model is measured and written to the file
+   remove(profile.c_str());
+   smoothCostThreads = 0;
+   calibrateSmoothCost();
+   ifstream file(profile.c_str());
+   int cachedThreads = 0;
+   bool written = bool(file >> cachedThreads) && (cachedThreads == threads);
+   for(int t=0; t<NUM_SMOOTH_TYPES && written; t++){
+      double value;
+      written = bool(file >> value) && (value > 0);
+   }
+   file.close();
+   if (error.empty() && !written){
+      error = "Calibrated cost model is not written to DIP_COST_PROFILE!";
+   }
+
+   remove(profile.c_str());
+   if (previous){
+      setenv("DIP_COST_PROFILE", saved.c_str(), 1);
+   }else{
+      unsetenv("DIP_COST_PROFILE");
+   }
+
+   if (!error.empty()){
+      cout << "ERROR: Dip3::autoSmoothType(): " << error << endl;
+      return;
+   }
+   cout << "Message: Dip3::autoSmoothType() seems to be correct" << endl;
+}
@@ -0,0 +1,92 @@
+//============================================================================
+// Name        : Dip3.h
+// Author      : Ronny Haensch
+// Version     : 2.0
+// Copyright   : -
+// Description : header file for third DIP assignment
+//============================================================================
+
+#include <iostream>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+class Dip3{
+
+   // the benchmark suite times the processing routines directly
+   friend class Benchmark;
+
+   public:
+      // constructor
+      Dip3(void) : borderType(BORDER_REPLICATE), sigma(0){};
+      // destructor
+      ~Dip3(void){};
+
+      // processing routines
+      // start unsharp masking
+      Mat run(Mat& in, int smoothType, int size, double thresh, double scale);
+      // testing routine
+      void test(void);
+      // border policy of the frequency domain convolution (OpenCV border type, default BORDER_REPLICATE)
+      void setBorderType(int type){ borderType = type; };
+      // standard deviation of the gaussian smoothing kernels
+      // (<= 0, the default: max(1, (size-1)/6) for a kernel of given size, which covers +-3 standard deviations)
+      void setSigma(double s){ sigma = s; };
+
+   private:
+      // function headers of functions to be implemented
+      // --> edit ONLY these functions!
+      // generates a gaussian filter kernel of given size
+      Mat createGaussianKernel(int kSize);
+      // generates the 1D factor (1 x kSize) of createGaussianKernel()
+      Mat createGaussianKernel1D(int kSize);
+      // standard deviation of the gaussian kernels of given size
+      double gaussianSigma(int kSize);
+      // true if the constant cost filters (satFilter(), recursiveFilter()) approximate the kernel of given size
+      bool approximatesGaussian(int kSize);
+      // performs a circular shift in (dx,dy) direction
+      Mat circShift(Mat& in, int dx, int dy);
+      // performs convolution by multiplication in frequency domain
+      Mat frequencyConvolution(Mat& in, Mat& kernel);
+      // performs unsharp masking to enhance fine image structures
+      Mat usm(Mat& in, int type, int size, double thresh, double scale);
+      // performs spatial convolution of image and filter kernel
+      Mat spatialConvolution(Mat& src, Mat& kernel);
+      // convolution in spatial domain by seperable filters
+      Mat seperableFilter(Mat& src, int size);
+      // convolution in spatial domain by integral images
+      Mat satFilter(Mat& src, int size);
+      // convolution by a recursive approximation of the gaussian, constant cost per pixel
+      Mat recursiveFilter(Mat& src, int size);
+
+      // function headers of given functions
+      // performs smoothing operation by convolution
+      Mat mySmooth(Mat& in, int size, int type);
+
+      // automatic choice of the smoothing type
+      // fastest type that computes the gaussian convolution (exactly, or approximately by types 3 and 6
+      // where approximatesGaussian()), according to the cost model
+      int autoSmoothType(Mat& in, int size);
+      // estimated time in milliseconds of smoothing type for the given image and kernel size
+      double smoothCost(int type, int rows, int cols, int size);
+      // measures the cost model once per thread count, or loads it from the cached profile
+      void calibrateSmoothCost(void);
+
+      // test functions
+      void test_createGaussianKernel(void);
+      void test_circShift(void);
+      void test_frequencyConvolution(void);
+      void test_seperableFilter(void);
+      void test_satFilter(void);
+      void test_recursiveFilter(void);
+      void test_autoSmoothType(void);
+      void test_usm(void);
+      // textured image for tests and calibration
+      Mat patternImage(int rows, int cols);
+
+      // border policy of the frequency domain convolution
+      int borderType;
+      // standard deviation of the gaussian kernels, see setSigma()
+      double sigma;
+};
@@ -0,0 +1,54 @@
+//============================================================================
+// Name        : main.cpp
+// Author      : Ronny Haensch
+// Version     : 2.0
+// Copyright   : -
+// Description : only calls processing and test routines
+//============================================================================
+
+#include <iostream>
+
+#include "Dip3.h"
+
+using namespace std;
+
+// usage: path to image in argv[1], optional smoothing type, kernel size, threshold and scale of
+// the unsharp masking in argv[2..5] (defaults: 2, 3, 0, 1.5)
+// main function. loads image, calls unsharp masking, saves result
+int main(int argc, char** argv) {
+
+   // check if image path was defined
+   if (argc < 2){
+      cout << "Usage: dip3 path_to_image [smoothType size thresh scale]" << endl;
+      cout << "Press enter to continue..." << endl;
+      cin.get();
+      return -1;
+   }
+
+   // construct processing object
+   Dip3 dip3;
+
+   // run some test routines
+   // NOTE: uncomment the following line for debugging/testing purposes!
+   //dip3.test();
+
+   // load image as grayscale, convert to 32F
+   Mat img = imread(argv[1], 0);
+   if (!img.data){
+      cout << "ERROR: image " << argv[1] << " not found" << endl;
+      return -1;
+   }
+   img.convertTo(img, CV_32FC1);
+
+   int smoothType = (argc > 2) ? atoi(argv[2]) : 2;
+   int size = (argc > 3) ? atoi(argv[3]) : 3;
+   double thresh = (argc > 4) ? atof(argv[4]) : 0;
+   double scale = (argc > 5) ? atof(argv[5]) : 1.5;
+
+   // unsharp masking
+   Mat result = dip3.run(img, smoothType, size, thresh, scale);
+   imwrite("original.png", img);
+   imwrite("sharpened.png", result);
+
+   return 0;
+}
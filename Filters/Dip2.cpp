@@ -8,7 +8,158 @@
 
 #include "Dip2.h"
 
+#include "../Common/ConvEngine.h"
+#include "../Common/NoiseGenerator.h"
+#include "../Common/ThreadPool.h"
+
+#include <cfloat>
+#include <sstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// SIMD helpers of the row kernels: VLEN neighbouring pixels are processed together
+#if defined(__AVX2__)
+typedef __m256 vfloat;
+static const int VLEN = 8;
+static inline vfloat vload(const float* p){ return _mm256_loadu_ps(p); }
+static inline void vstore(float* p, vfloat v){ _mm256_storeu_ps(p, v); }
+static inline vfloat vmin(vfloat a, vfloat b){ return _mm256_min_ps(a, b); }
+static inline vfloat vmax(vfloat a, vfloat b){ return _mm256_max_ps(a, b); }
+#elif defined(__SSE2__)
+typedef __m128 vfloat;
+static const int VLEN = 4;
+static inline vfloat vload(const float* p){ return _mm_loadu_ps(p); }
+static inline void vstore(float* p, vfloat v){ _mm_storeu_ps(p, v); }
+static inline vfloat vmin(vfloat a, vfloat b){ return _mm_min_ps(a, b); }
+static inline vfloat vmax(vfloat a, vfloat b){ return _mm_max_ps(a, b); }
+#else
+typedef float vfloat;
+static const int VLEN = 1;
+static inline vfloat vload(const float* p){ return *p; }
+static inline void vstore(float* p, vfloat v){ *p = v; }
+static inline vfloat vmin(vfloat a, vfloat b){ return a < b ? a : b; }
+static inline vfloat vmax(vfloat a, vfloat b){ return a < b ? b : a; }
+#endif
+
+// extra columns right of a padded row that the SIMD row kernels may read
+static const int ROW_PAD = 2*VLEN;
+
+// compare-exchange: afterwards a <= b
+static inline void sortPair(vfloat& a, vfloat& b){
+	vfloat t = vmin(a, b);
+	b = vmax(a, b);
+	a = t;
+}
+
+// median of three
+static inline vfloat median3(vfloat a, vfloat b, vfloat c){
+	return vmax(vmin(a, b), vmin(vmax(a, b), c));
+}
+
+// sorting networks for 3 and 5 values
+static inline void sort3(vfloat* v){
+	sortPair(v[0], v[1]); sortPair(v[1], v[2]); sortPair(v[0], v[1]);
+}
+static inline void sort5(vfloat* v){
+	sortPair(v[0], v[3]); sortPair(v[1], v[4]);
+	sortPair(v[0], v[2]); sortPair(v[1], v[3]);
+	sortPair(v[0], v[1]); sortPair(v[2], v[4]);
+	sortPair(v[1], v[2]); sortPair(v[3], v[4]);
+	sortPair(v[2], v[3]);
+}
+
+// sorts the columns of a K x width window of padded rows into colBuf (K rows of colStride floats)
+// every sorted column is shared by the K output pixels that contain it
+template<int K>
+static void sortColumns(const float* const* rows, int width, float* colBuf, int colStride){
+	for (int x = 0; x < width; x += VLEN){
+		vfloat v[K];
+		for (int k = 0; k < K; k++){
+			v[k] = vload(rows[k] + x);
+		}
+		if (K == 3){
+			sort3(v);
+		}else{
+			sort5(v);
+		}
+		for (int k = 0; k < K; k++){
+			vstore(colBuf + k*colStride + x, v[k]);
+		}
+	}
+}
+
+// median of one output row by a sorting network (K = 3 or 5)
+/*
+rows:    K input rows, padded by K/2 replicated pixels on the left and by
+         K/2 + ROW_PAD on the right (rows[k][0] is column -K/2)
+width:   number of output pixels
+colBuf:  scratch buffer of K*(width + K + ROW_PAD) floats
+dst:     output row, room for width + VLEN floats
+*/
+template<int K>
+static void medianNetworkRow(const float* const* rows, int width, float* colBuf, float* dst);
+
+// 3x3: with sorted columns (lo <= mid <= hi) the median of the window is
+// med3( max of the lows, med3 of the mids, min of the highs )
+template<>
+void medianNetworkRow<3>(const float* const* rows, int width, float* colBuf, float* dst){
+	int stride = width + 3 + ROW_PAD;
+	sortColumns<3>(rows, width + 2, colBuf, stride);
+	const float* lo = colBuf;
+	const float* mid = colBuf + stride;
+	const float* hi = colBuf + 2*stride;
+	for (int x = 0; x < width; x += VLEN){
+		vfloat maxLo = vmax(vmax(vload(lo + x), vload(lo + x + 1)), vload(lo + x + 2));
+		vfloat medMid = median3(vload(mid + x), vload(mid + x + 1), vload(mid + x + 2));
+		vfloat minHi = vmin(vmin(vload(hi + x), vload(hi + x + 1)), vload(hi + x + 2));
+		vstore(dst + x, median3(maxLo, medMid, minHi));
+	}
+}
+
+// 5x5: columns are sorted once and shared; per output the rows of equal rank are sorted too.
+// In a matrix with sorted rows and columns, element (r,c) has at least (r+1)(c+1) elements
+// below and (5-r)(5-c) above it, which leaves 13 candidates, 6 known to be smaller and
+// 6 known to be larger than the median. Their median (forgetful selection) is the result
+template<>
+void medianNetworkRow<5>(const float* const* rows, int width, float* colBuf, float* dst){
+	int stride = width + 5 + ROW_PAD;
+	sortColumns<5>(rows, width + 4, colBuf, stride);
+	for (int x = 0; x < width; x += VLEN){
+		vfloat m[5][5];
+		for (int r = 0; r < 5; r++){
+			for (int c = 0; c < 5; c++){
+				m[r][c] = vload(colBuf + r*stride + x + c);
+			}
+			sort5(m[r]);
+		}
+		vfloat v[13] = { m[0][3], m[0][4], m[1][2], m[1][3], m[1][4],
+		                 m[2][1], m[2][2], m[2][3], m[3][0], m[3][1],
+		                 m[3][2], m[4][0], m[4][1] };
+		// forgetful selection: keep 8 values, repeatedly drop min and max and take the next one
+		int n = 8;
+		for (int next = 8; next < 13; next++){
+			for (int i = 1; i < n; i++){
+				sortPair(v[0], v[i]);
+			}
+			for (int i = 1; i < n - 1; i++){
+				sortPair(v[i], v[n - 1]);
+			}
+			for (int i = 0; i < n - 2; i++){
+				v[i] = v[i + 1];
+			}
+			v[n - 2] = v[next];
+			n = n - 1;
+		}
+		vstore(dst + x, median3(v[0], v[1], v[2]));
+	}
+}
+
 // convolution in spatial domain
+// the work is done by the shared tiled/multithreaded engine (see Common/ConvEngine)
 /*
 src:     input image
 kernel:  filter kernel
@@ -16,92 +167,98 @@ return:  convolution result
 */
 Mat Dip2::spatialConvolution(Mat& src, Mat& kernel) {
 
+	ConvEngine engine;
 
+	return engine.convolve(src, kernel);
+}
+
+// the average filter
+// sliding window: running column sums are updated once per row and a running sum along
+// the row is updated once per pixel, so the cost per pixel does not depend on kSize.
+// Indices outside of the image are clamped (replicated border) as in spatialConvolution()
+/*
+src:     input image
+kSize:   window size used by local average
+return:  filtered image
+*/
+Mat Dip2::averageFilter(Mat& src, int kSize) {
 
-	int kSize = kernel.rows;
-	// we assume kernel is a square matrix
 	int srcRow = src.rows;
 	int srcCol = src.cols;
+	int before = (kSize - 1) / 2;
+	int after = kSize - 1 - before;
+	double norm = 1. / (kSize*kSize);
 
-  Mat output =  Mat::zeros(srcRow,srcCol, CV_32FC1);
-
+	Mat output = Mat::zeros(srcRow, srcCol, CV_32FC1);
 
-  // flip the kernel 
+	// rows are processed in bands, each band starts its own column sums
+	int bandRows = max(64, 4*kSize);
+	int numBands = (srcRow + bandRows - 1) / bandRows;
 
-  Mat kernel_flip =  Mat::zeros(kSize,kSize, CV_32FC1);
+	ThreadPool::instance().parallelFor(numBands, [&](int band){
 
-  for (int k = 0 ; k < kSize ; k ++)
-  {
-    for (int l = 0 ; l < kSize ; l ++)
-    {
-      kernel_flip.at<float>(k, l) = kernel.at<float>(kSize - 1 - k, kSize - 1 - l);
-    }
-  }
+		int first = band * bandRows;
+		int last = min(srcRow, first + bandRows);
 
-	
+		// colSum[j] = sum of column j over the rows first-before .. first+after (clamped)
+		// sums are kept in double, so adding and removing rows does not accumulate errors
+		vector<double> colSum(srcCol, 0.);
+		for (int k = -before; k <= after; k++)
+		{
+			const float* s = src.ptr<float>(clampIndex(first + k, srcRow));
+			for (int j = 0; j < srcCol; j++)
+			{
+				colSum[j] += s[j];
+			}
+		}
 
-	for (int i = 0; i < srcRow; i++)
-	{
-		for (int j = 0; j < srcCol; j++)
+		for (int i = first; i < last; i++)
 		{
-      float res = 0; //  will contain the sum of all the convoluted terms.
+			float* out = output.ptr<float>(i);
 
-			for (int k = 0; k < kSize; k++)
+			// window sum of the first pixel, then slide along the row
+			double res = 0;
+			for (int l = -before; l <= after; l++)
 			{
-				int k_src = i - (kSize - 1) / 2 + k;
-				if (k_src < 0)
-				{
-					k_src = 0;
-				}
-				else if (k_src >= srcRow)
-				{
-					k_src = srcRow - 1;
-				}
-				for (int l = 0; l < kSize; l++)
-				{
-					int l_src = j + l - (kSize - 1) / 2;
-					if (l_src < 0)
-					{
-						l_src = 0;
-					}
-					else if (l_src >= srcCol)
-					{
-						l_src = srcCol - 1;
-					}
+				res += colSum[clampIndex(l, srcCol)];
+			}
+			for (int j = 0; j < srcCol; j++)
+			{
+				out[j] = res * norm;
+				res += colSum[clampIndex(j + 1 + after, srcCol)] - colSum[clampIndex(j - before, srcCol)];
+			}
 
-					res = res + src.at<float>(k_src,l_src) * kernel_flip.at<float>(k, l);
+			// move column sums down by one row
+			if (i + 1 < last)
+			{
+				const float* add = src.ptr<float>(clampIndex(i + 1 + after, srcRow));
+				const float* sub = src.ptr<float>(clampIndex(i - before, srcRow));
+				for (int j = 0; j < srcCol; j++)
+				{
+					colSum[j] += add[j] - sub[j];
 				}
 			}
-
-			output.at<float>(i,j) = res;
-
-      
 		}
-		
-	}
+	});
 
 	return output;
 }
 
-// the average filter
-// HINT: you might want to use Dip2::spatialConvolution(...) within this function
+// clamps an index to 0 .. size-1 (replicated border)
 /*
-src:     input image
-kSize:   window size used by local average
-return:  filtered image
+idx:     index, may lie outside of the image
+size:    number of rows/columns
+return:  clamped index
 */
-Mat Dip2::averageFilter(Mat& src, int kSize) {
-	
-	Mat kernel = Mat::ones(kSize, kSize, CV_32FC1);
-  kernel = kernel/(kSize*kSize);
-  
-	Mat output = spatialConvolution(src, kernel);
-	
-	return output;
-}
+int Dip2::clampIndex(int idx, int size) {
 
+	return idx < 0 ? 0 : (idx >= size ? size - 1 : idx);
+}
 
 // the median filter
+// 8-bit images and float images holding integral grey values (e.g. loaded from jpg) use a
+// sliding histogram whose cost per pixel does not depend on kSize (see medianHistogram()),
+// all other images are handled by sorting the window
 /*
 src:     input image
 kSize:   window size used by median operation
@@ -110,6 +267,16 @@ return:  filtered image
 Mat Dip2::medianFilter(Mat& src, int kSize) {
 	// we assume here that kSize is a odd number
 
+	if ( (src.type() == CV_32FC1) && ( (kSize == 3) || (kSize == 5) ) )
+	{
+		return medianNetwork(src, kSize);
+	}
+
+	Mat src8;
+	if (quantize8U(src, src8))
+	{
+		return medianHistogram(src8, kSize);
+	}
 
 	int srcRow = src.rows;
 	int srcCol = src.cols;
@@ -117,54 +284,450 @@ Mat Dip2::medianFilter(Mat& src, int kSize) {
     
   Mat output =  Mat::zeros(srcRow,srcCol, CV_32FC1);
 
-  for (int i = 0; i < srcRow; i++)
-	{
+  ThreadPool::instance().parallelFor(srcRow, [&](int i){
+
+		// window lives on the heap, a stack array of kSize*kSize floats overflows for large windows
+		vector<float> tab(size);
+
 		for (int j = 0; j < srcCol; j++)
 		{
-			float tab[size];
 			int t = 0;
 
       for (int k = 0; k < kSize; k++)
       {
-        int k_src = i - (kSize - 1) / 2 + k;
-        if (k_src < 0)
-        {
-          k_src = 0;
-        }
-        else if (k_src >= srcRow)
-        {
-          k_src = srcRow - 1;
-        }
+        const float* s = src.ptr<float>(clampIndex(i - (kSize - 1) / 2 + k, srcRow));
         for (int l = 0; l < kSize; l++)
         {
-          int l_src = j + l - (kSize - 1) / 2;
-          if (l_src < 0)
-          {
-            l_src = 0;
-          }
-          else if (l_src >= srcCol)
-          {
-            l_src = srcCol - 1;
-          }
-          
-          tab[t] = src.at<float>(k_src, l_src);
+          tab[t] = s[clampIndex(j + l - (kSize - 1) / 2, srcCol)];
           t = t + 1;
         }
       }
-      
 
-			std::sort(tab, tab+size); // sort the element of tab
+			// only the middle element has to be in place
+			nth_element(tab.begin(), tab.begin() + (size - 1)/2, tab.end());
 			float med = tab[(size - 1)/2]; 
 		  output.at<float>(i,j) = med;
 		}
+	});
+
+   return output;
+}
+
+// range weights of the bilateral filter: lut[n] = exp(-(n/scale)^2 / (2 sigma^2))
+/*
+src:     input image
+sigma:   standard-deviation of radiometric kernel
+lut:     the table, covers all differences between two pixels of src
+return:  scale, the table is indexed by round(|difference| * scale)
+*/
+static float bilateralRangeTable(Mat& src, double sigma, vector<float>& lut){
+
+	double minVal, maxVal;
+	minMaxLoc(src, &minVal, &maxVal);
+	double range = maxVal - minVal;
+
+	// 16 steps per grey value, integral differences hit the table exactly
+	double scale = 16;
+	if (range * scale > 65536){
+		scale = 65536 / range;
+	}
+	int size = (int)(range * scale) + 2;
+
+	lut.resize(size);
+	for (int n = 0; n < size; n++){
+		double d = n / scale;
+		if (sigma > 0){
+			lut[n] = exp( -(d*d) / (2*sigma*sigma) );
+			// weights below the float range would only be denormals and slow down every operation
+			if (lut[n] < FLT_MIN){
+				lut[n] = 0;
+			}
+		}else{
+			lut[n] = (n == 0) ? 1 : 0;
+		}
 	}
+	return scale;
+}
 
+// bilateral filter of one output row
+/*
+rows:     kSize input rows, padded by (kSize-1)/2 replicated pixels on the left and by
+          kSize/2 + ROW_PAD on the right (rows[k][0] is column -(kSize-1)/2)
+width:    number of output pixels
+kSize:    window size
+spatial:  spatial weights, kSize*kSize values row by row
+lut:      range weights, see bilateralRangeTable()
+scale:    index scale of lut
+dst:      output row, room for width + VLEN floats
+*/
+static void bilateralRow(const float* const* rows, int width, int kSize, const float* spatial, const float* lut, float scale, float* dst){
+
+	int before = (kSize - 1) / 2;
+	int x = 0;
+
+#if defined(__AVX2__)
+	const __m256 signMask = _mm256_set1_ps(-0.f);
+	const __m256 vscale = _mm256_set1_ps(scale);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	for (; x < width; x += 8){
+		__m256 center = _mm256_loadu_ps(rows[before] + x + before);
+		__m256 res = _mm256_setzero_ps();
+		__m256 z = _mm256_setzero_ps();
+		for (int k = 0; k < kSize; k++){
+			const float* s = rows[k] + x;
+			const float* w = spatial + k*kSize;
+			for (int l = 0; l < kSize; l++){
+				__m256 v = _mm256_loadu_ps(s + l);
+				__m256 d = _mm256_andnot_ps(signMask, _mm256_sub_ps(v, center));
+				__m256i idx = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(d, vscale), half));
+				__m256 h = _mm256_mul_ps(_mm256_i32gather_ps(lut, idx, 4), _mm256_set1_ps(w[l]));
+				res = _mm256_add_ps(res, _mm256_mul_ps(h, v));
+				z = _mm256_add_ps(z, h);
+			}
+		}
+		_mm256_storeu_ps(dst + x, _mm256_div_ps(res, z));
+	}
+#elif defined(__SSE2__)
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	const __m128 vscale = _mm_set1_ps(scale);
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; x < width; x += 4){
+		__m128 center = _mm_loadu_ps(rows[before] + x + before);
+		__m128 res = _mm_setzero_ps();
+		__m128 z = _mm_setzero_ps();
+		int idx[4];
+		for (int k = 0; k < kSize; k++){
+			const float* s = rows[k] + x;
+			const float* w = spatial + k*kSize;
+			for (int l = 0; l < kSize; l++){
+				__m128 v = _mm_loadu_ps(s + l);
+				__m128 d = _mm_andnot_ps(signMask, _mm_sub_ps(v, center));
+				_mm_storeu_si128((__m128i*)idx, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(d, vscale), half)));
+				__m128 h = _mm_mul_ps(_mm_set_ps(lut[idx[3]], lut[idx[2]], lut[idx[1]], lut[idx[0]]), _mm_set1_ps(w[l]));
+				res = _mm_add_ps(res, _mm_mul_ps(h, v));
+				z = _mm_add_ps(z, h);
+			}
+		}
+		_mm_storeu_ps(dst + x, _mm_div_ps(res, z));
+	}
+#endif
+
+	for (; x < width; x++){
+		float center = rows[before][x + before];
+		float res = 0;
+		float z = 0;
+		for (int k = 0; k < kSize; k++){
+			for (int l = 0; l < kSize; l++){
+				float v = rows[k][x + l];
+				float h = lut[(int)(fabs(v - center) * scale + 0.5f)] * spatial[k*kSize + l];
+				res = res + h * v;
+				z = z + h;
+			}
+		}
+		dst[x] = res / z;
+	}
+}
 
+// moving average of one output row
+/*
+rows:    kSize input rows, padded by (kSize-1)/2 replicated pixels on the left and by
+         kSize/2 + ROW_PAD on the right (rows[k][0] is column -(kSize-1)/2)
+width:   number of output pixels
+kSize:   window size
+colSum:  scratch buffer of width + kSize doubles
+dst:     output row
+*/
+static void averageRow(const float* const* rows, int width, int kSize, double* colSum, float* dst){
 
-   return output;
+	for (int x = 0; x < width + kSize - 1; x++){
+		colSum[x] = 0;
+	}
+	for (int k = 0; k < kSize; k++){
+		for (int x = 0; x < width + kSize - 1; x++){
+			colSum[x] += rows[k][x];
+		}
+	}
+
+	double norm = 1. / (kSize*kSize);
+	double res = 0;
+	for (int l = 0; l < kSize; l++){
+		res += colSum[l];
+	}
+	for (int x = 0; x < width; x++){
+		dst[x] = res * norm;
+		res += colSum[x + kSize] - colSum[x];
+	}
+}
+
+// median of one output row for any window size
+/*
+rows:    kSize input rows, padded as for averageRow()
+width:   number of output pixels
+kSize:   window size
+tab:     scratch buffer of kSize*kSize floats
+dst:     output row
+*/
+static void medianRow(const float* const* rows, int width, int kSize, float* tab, float* dst){
+
+	int size = kSize*kSize;
+	for (int x = 0; x < width; x++){
+		int t = 0;
+		for (int k = 0; k < kSize; k++){
+			for (int l = 0; l < kSize; l++){
+				tab[t++] = rows[k][x + l];
+			}
+		}
+		nth_element(tab, tab + (size - 1)/2, tab + size);
+		dst[x] = tab[(size - 1)/2];
+	}
+}
+
+// median filter for 3x3 and 5x5 windows by SIMD sorting networks
+/*
+src:     input image (CV_32FC1)
+kSize:   window size, 3 or 5
+return:  filtered image
+*/
+Mat Dip2::medianNetwork(Mat& src, int kSize) {
+
+	int srcRow = src.rows;
+	int srcCol = src.cols;
+	int before = kSize / 2;
+
+	Mat output = Mat::zeros(srcRow, srcCol, CV_32FC1);
+
+	// replicated border, the right side also covers the columns read by the last vector
+	Mat padded;
+	copyMakeBorder(src, padded, before, before, before, before + ROW_PAD, BORDER_REPLICATE);
+
+	int bandRows = 32;
+	int numBands = (srcRow + bandRows - 1) / bandRows;
+
+	ThreadPool::instance().parallelFor(numBands, [&](int band){
+
+		vector<float> colBuf(kSize*(srcCol + kSize + ROW_PAD));
+		vector<float> dst(srcCol + VLEN);
+		const float* rows[5];
+
+		for (int i = band*bandRows; i < min(srcRow, (band + 1)*bandRows); i++)
+		{
+			for (int k = 0; k < kSize; k++)
+			{
+				rows[k] = padded.ptr<float>(i + k);
+			}
+			if (kSize == 3)
+			{
+				medianNetworkRow<3>(rows, srcCol, &colBuf[0], &dst[0]);
+			}
+			else
+			{
+				medianNetworkRow<5>(rows, srcCol, &colBuf[0], &dst[0]);
+			}
+			memcpy(output.ptr<float>(i), &dst[0], srcCol*sizeof(float));
+		}
+	});
+
+	return output;
+}
+
+// converts an image to 8 bit if this does not change any value
+/*
+src:     input image (CV_8UC1 or CV_32FC1)
+dst:     8-bit copy of src
+return:  true if src only contains integral values in 0..255
+*/
+bool Dip2::quantize8U(Mat& src, Mat& dst) {
+
+	if (src.type() == CV_8UC1)
+	{
+		dst = src;
+		return true;
+	}
+	if (src.type() != CV_32FC1)
+	{
+		return false;
+	}
+
+	dst.create(src.rows, src.cols, CV_8UC1);
+	for (int i = 0; i < src.rows; i++)
+	{
+		const float* s = src.ptr<float>(i);
+		uchar* d = dst.ptr<uchar>(i);
+		for (int j = 0; j < src.cols; j++)
+		{
+			if ( !(s[j] >= 0) || (s[j] > 255) || (s[j] != floor(s[j])) )
+			{
+				return false;
+			}
+			d[j] = (uchar)s[j];
+		}
+	}
+	return true;
+}
+
+// median filter by sliding histograms (Perreault & Hebert, "Median filtering in constant time")
+// every column keeps a histogram of the kSize pixels around the current row, updated by one
+// pixel in and one out per row. The window histogram is the sum of kSize column histograms and
+// slides by adding one column and removing one. Histograms are split into 16 coarse bins and
+// 16x16 fine bins; a fine segment is only brought up to date when the median falls into it
+/*
+src:     8-bit input image
+kSize:   window size used by median operation
+return:  filtered image (CV_32FC1)
+*/
+Mat Dip2::medianHistogram(Mat& src, int kSize) {
+
+	int srcRow = src.rows;
+	int srcCol = src.cols;
+	int before = (kSize - 1) / 2;
+	int after = kSize - 1 - before;
+	// rank of the median inside of the window
+	int rank = (kSize*kSize - 1) / 2;
+
+	Mat output = Mat::zeros(srcRow, srcCol, CV_32FC1);
+
+	// the image is processed in vertical strips, each strip keeps the column histograms it needs
+	int stripCols = 256;
+	int numStrips = (srcCol + stripCols - 1) / stripCols;
+
+	ThreadPool::instance().parallelFor(numStrips, [&](int strip){
+
+		int first = strip * stripCols;
+		int last = min(srcCol, first + stripCols);
+		// columns whose histograms are needed
+		int histFirst = max(0, first - before);
+		int histLast = min(srcCol, last + after);
+		int numHist = histLast - histFirst;
+
+		vector<unsigned short> colCoarse(numHist*16, 0);
+		vector<unsigned short> colFine(numHist*256, 0);
+
+		// window histogram and the column each fine segment is valid for
+		int coarse[16];
+		int fine[256];
+		int valid[16];
+
+		for (int i = 0; i < srcRow; i++)
+		{
+			// update column histograms: the row clamp(i-1-before) leaves, the row clamp(i+after) enters
+			if (i == 0)
+			{
+				for (int k = -before; k <= after; k++)
+				{
+					const uchar* s = src.ptr<uchar>(clampIndex(k, srcRow));
+					for (int x = 0; x < numHist; x++)
+					{
+						colCoarse[x*16 + (s[histFirst + x] >> 4)]++;
+						colFine[x*256 + s[histFirst + x]]++;
+					}
+				}
+			}
+			else
+			{
+				int out = clampIndex(i - 1 - before, srcRow);
+				int in = clampIndex(i + after, srcRow);
+				if (in != out)
+				{
+					const uchar* so = src.ptr<uchar>(out);
+					const uchar* si = src.ptr<uchar>(in);
+					for (int x = 0; x < numHist; x++)
+					{
+						colCoarse[x*16 + (so[histFirst + x] >> 4)]--;
+						colFine[x*256 + so[histFirst + x]]--;
+						colCoarse[x*16 + (si[histFirst + x] >> 4)]++;
+						colFine[x*256 + si[histFirst + x]]++;
+					}
+				}
+			}
+
+			// window histogram of the first column of the strip
+			for (int c = 0; c < 16; c++)
+			{
+				coarse[c] = 0;
+				valid[c] = first - kSize - 1;
+			}
+			for (int l = -before; l <= after; l++)
+			{
+				const unsigned short* h = &colCoarse[(clampIndex(first + l, srcCol) - histFirst)*16];
+				for (int c = 0; c < 16; c++)
+				{
+					coarse[c] += h[c];
+				}
+			}
+
+			float* dst = output.ptr<float>(i);
+			for (int j = first; j < last; j++)
+			{
+				if (j > first)
+				{
+					const unsigned short* hin = &colCoarse[(clampIndex(j + after, srcCol) - histFirst)*16];
+					const unsigned short* hout = &colCoarse[(clampIndex(j - 1 - before, srcCol) - histFirst)*16];
+					for (int c = 0; c < 16; c++)
+					{
+						coarse[c] += hin[c] - hout[c];
+					}
+				}
+
+				// coarse segment containing the median
+				int sum = 0;
+				int c = 0;
+				while (sum + coarse[c] <= rank)
+				{
+					sum += coarse[c];
+					c++;
+				}
+
+				// bring fine segment c up to date for column j
+				int* f = fine + c*16;
+				if (j - valid[c] >= kSize)
+				{
+					for (int b = 0; b < 16; b++)
+					{
+						f[b] = 0;
+					}
+					for (int l = -before; l <= after; l++)
+					{
+						const unsigned short* h = &colFine[(clampIndex(j + l, srcCol) - histFirst)*256 + c*16];
+						for (int b = 0; b < 16; b++)
+						{
+							f[b] += h[b];
+						}
+					}
+				}
+				else
+				{
+					for (int x = valid[c] + 1; x <= j; x++)
+					{
+						const unsigned short* hin = &colFine[(clampIndex(x + after, srcCol) - histFirst)*256 + c*16];
+						const unsigned short* hout = &colFine[(clampIndex(x - 1 - before, srcCol) - histFirst)*256 + c*16];
+						for (int b = 0; b < 16; b++)
+						{
+							f[b] += hin[b] - hout[b];
+						}
+					}
+				}
+				valid[c] = j;
+
+				// fine bin containing the median
+				int b = 0;
+				while (sum + f[b] <= rank)
+				{
+					sum += f[b];
+					b++;
+				}
+				dst[j] = c*16 + b;
+			}
+		}
+	});
+
+	return output;
 }
 
 // the bilateral filter
+// the spatial weights only depend on the tap offset and are computed once, the radiometric
+// weights are taken from a table (see bilateralRangeTable()). The interior is computed by
+// bilateralRow() for several pixels at once; for pixels near the border the spatial weight
+// uses the distance to the clamped tap position, as the per-pixel formula always did
 /*
 src:     input image
 kSize:   window size of kernel --> used to compute std-dev of spatial kernel
@@ -176,115 +739,213 @@ Mat Dip2::bilateralFilter(Mat& src, int kSize, double sigma){
   int srcRow = src.rows;
   int srcCol = src.cols;
   float sigmaK = kSize/2; 
+  // taps cover i-before .. i+after (same for columns)
+  int before = (kSize - 1) / 2;
+  int after = kSize - 1 - before;
 
   Mat output =  Mat::zeros(srcRow,srcCol, CV_32FC1);
 
-
-  float hsp = 0;
-  float hrad = 0; // hsp and hrad will be the spatial and radiometric weight.
- 
-
-  for (int i = 0; i < srcRow; i++)
+  // spatial weight along one axis, hsp(k,l) = g[k]*g[l]
+  vector<float> g(kSize);
+  for (int k = 0; k < kSize; k++)
+  {
+    g[k] = (sigmaK > 0) ? exp( -( (k - before)*(k - before) ) / (2*sigmaK*sigmaK) ) : 1;
+  }
+  vector<float> spatial(kSize*kSize);
+  for (int k = 0; k < kSize; k++)
   {
-    for (int j = 0; j < srcCol; j++)
+    for (int l = 0; l < kSize; l++)
     {
-      float res = 0; //  will contain the sum of all the convoluted terms. 
-      float z = 0;
+      spatial[k*kSize + l] = g[k]*g[l];
+    }
+  }
+
+  // radiometric weights
+  vector<float> lut;
+  float scale = bilateralRangeTable(src, sigma, lut);
+
+  Mat padded;
+  copyMakeBorder(src, padded, before, after, before, after + ROW_PAD, BORDER_REPLICATE);
+
+  int bandRows = 16;
+  int numBands = (srcRow + bandRows - 1) / bandRows;
+
+  ThreadPool::instance().parallelFor(numBands, [&](int band){
 
+    vector<const float*> rows(kSize);
+    vector<float> dst(srcCol + VLEN);
+
+    for (int i = band*bandRows; i < min(srcRow, (band + 1)*bandRows); i++)
+    {
       for (int k = 0; k < kSize; k++)
       {
-        int k_src = i - (kSize - 1) / 2 + k;
-        if (k_src < 0)
-        {
-          k_src = 0;
-        }
-        else if (k_src >= srcRow)
+        rows[k] = padded.ptr<float>(i + k);
+      }
+      bilateralRow(&rows[0], srcCol, kSize, &spatial[0], &lut[0], scale, &dst[0]);
+      memcpy(output.ptr<float>(i), &dst[0], srcCol*sizeof(float));
+
+      // border band: taps are clamped, their spatial weight uses the clamped position
+      bool borderRow = (i < before) || (i >= srcRow - after);
+      for (int j = 0; j < srcCol; j++)
+      {
+        if ( !borderRow && (j >= before) && (j < srcCol - after) )
         {
-          k_src = srcRow - 1;
+          j = srcCol - after - 1;
+          continue;
         }
-        for (int l = 0; l < kSize; l++)
+        float center = src.at<float>(i,j);
+        float res = 0; //  will contain the sum of all the convoluted terms. 
+        float z = 0;
+        for (int k = 0; k < kSize; k++)
         {
-          int l_src = j + l - (kSize - 1) / 2;
-          if (l_src < 0)
-          {
-            l_src = 0;
-          }
-          else if (l_src >= srcCol)
+          int k_src = clampIndex(i - before + k, srcRow);
+          const float* s = src.ptr<float>(k_src);
+          for (int l = 0; l < kSize; l++)
           {
-            l_src = srcCol - 1;
+            int l_src = clampIndex(j - before + l, srcCol);
+            float h = g[k_src - i + before] * g[l_src - j + before] * lut[(int)(fabs(s[l_src] - center) * scale + 0.5f)];
+            res = res + h * s[l_src];
+            z = z + h;
           }
-         
-          hsp = exp( -(  (k_src - i)*(k_src - i) + (l_src - j)*(l_src - j) ) / (2*sigmaK*sigmaK) ); // spatial weight
-
-          hrad =  exp( -( ( src.at<float>(k_src,l_src) - src.at<float>(i,j) )* ( src.at<float>(k_src,l_src) - src.at<float>(i,j) ) ) / (2*sigma*sigma) ) ;  // radiometric weight
-
-          res = res + hsp * hrad * src.at<float>(k_src,l_src) ; 
-
-          z = z + hsp * hrad;
-
         }
+        output.at<float>(i,j) = res/z;
       }
-
-      output.at<float>(i,j) = res/z;
-      
     }
-    
-  }
+  });
   
     return output;
 
 }
 
 // the non-local means filter
+// the weight of a pixel q in the search region of p depends on the mean squared difference
+// of the patches around p and q. For each search offset d the squared differences
+// (I(x) - I(x+d))^2 are summed into an integral image, so every patch distance costs four
+// lookups whatever the patch size (Darbon et al., "Fast nonlocal filtering applied to
+// electron cryomicroscopy"). The image is split into tiles that are processed in parallel
 /*
 src:   		input image
 searchSize: size of search region
 sigma: 		Optional parameter for weighting function
+patchSize:  size of compared patches (1 compares single pixels)
 return:  	filtered image
 */
-Mat Dip2::nlmFilter(Mat& src, int searchSize, double sigma){
+Mat Dip2::nlmFilter(Mat& src, int searchSize, double sigma, int patchSize){
   
   // we assume that searchSize odd number is
  // we are using a gaussian distribution, and sigma will be the standart deviation
 
   int srcRow = src.rows;
   int srcCol = src.cols;
+  // search offsets -searchBefore .. searchSize-1-searchBefore, patch radius
+  int searchBefore = (searchSize - 1) / 2;
+  int pr = patchSize / 2;
+  int patchArea = (2*pr + 1)*(2*pr + 1);
 
   Mat output =  Mat::zeros(srcRow,srcCol, CV_32FC1);
 
-
-  float w = 0; // w will be the weight function. It will follow a gaussian distribution, and will be equal to zero if we are outside the image
- 
-
-  for (int i = 0; i < srcRow; i++)
+  // weight w = exp(-dist/sigma^2) taken from a table over x = dist/sigma^2 in [0, NLM_LUT_RANGE)
+  const int NLM_LUT_STEPS = 256;
+  const int NLM_LUT_RANGE = 30;
+  vector<float> lut(NLM_LUT_RANGE*NLM_LUT_STEPS);
+  for (size_t n = 0; n < lut.size(); n++)
   {
-    for (int j = 0; j < srcCol; j++)
+    lut[n] = exp( -(double)n / NLM_LUT_STEPS );
+  }
+  double lutScale = (sigma > 0) ? NLM_LUT_STEPS / (sigma*sigma*patchArea) : 0;
+
+  const int tileSize = 64;
+  int tilesX = (srcCol + tileSize - 1) / tileSize;
+  int tilesY = (srcRow + tileSize - 1) / tileSize;
+
+  ThreadPool::instance().parallelFor(tilesX*tilesY, [&](int t){
+
+    int x0 = (t % tilesX) * tileSize;
+    int y0 = (t / tilesX) * tileSize;
+    int tw = min(tileSize, srcCol - x0);
+    int th = min(tileSize, srcRow - y0);
+    // tile extended by the patch radius
+    int ew = tw + 2*pr;
+    int eh = th + 2*pr;
+
+    vector<float> res(tw*th, 0.f); //  will contain the sum of all the terms. 
+    vector<float> z(tw*th, 0.f);
+    // integral image of the squared differences, one extra leading row and column of zeros
+    vector<double> sat((ew + 1)*(eh + 1), 0.);
+    vector<int> col(ew), colShift(ew);
+    vector<const float*> row(eh), rowShift(eh);
+
+    for (int e = 0; e < ew; e++)
     {
-      float res = 0; //  will contain the sum of all the terms. 
-      float z = 0;
+      col[e] = clampIndex(x0 - pr + e, srcCol);
+    }
+    for (int e = 0; e < eh; e++)
+    {
+      row[e] = src.ptr<float>(clampIndex(y0 - pr + e, srcRow));
+    }
 
-      for (int k = 0; k < searchSize; k++)
+    for (int dy = -searchBefore; dy < searchSize - searchBefore; dy++)
+    {
+      for (int e = 0; e < eh; e++)
+      {
+        rowShift[e] = src.ptr<float>(clampIndex(y0 - pr + e + dy, srcRow));
+      }
+      for (int dx = -searchBefore; dx < searchSize - searchBefore; dx++)
       {
-        int k_src = i - (searchSize - 1) / 2 + k;
-        for (int l = 0; l < searchSize; l++)
+        for (int e = 0; e < ew; e++)
         {
-          int l_src = j - (searchSize - 1) / 2 + l;
-          if ((l_src < 0) || (l_src >= srcCol) || (k_src < 0) || (k_src >= srcCol) ) // k_src and l_src are the pixe index on the image used to compare with i,j
-          {
-            w = 0;
-          }  
-          else
+          colShift[e] = clampIndex(x0 - pr + e + dx, srcCol);
+        }
+
+        // integral image of (I(x) - I(x+d))^2 over the extended tile
+        for (int y = 0; y < eh; y++)
+        {
+          const double* above = &sat[y*(ew + 1)];
+          double* cur = &sat[(y + 1)*(ew + 1)];
+          double rowSum = 0;
+          for (int x = 0; x < ew; x++)
           {
-            w = exp( -( ( src.at<float>(k_src,l_src) - src.at<float>(i,j) )* ( src.at<float>(k_src,l_src) - src.at<float>(i,j) ) ) / (sigma*sigma) );
+            double diff = row[y][col[x]] - rowShift[y][colShift[x]];
+            rowSum += diff*diff;
+            cur[x + 1] = above[x + 1] + rowSum;
           }
+        }
 
-          res = res + w*src.at<float>(i,j) ; 
-          z = z + w;
+        // weights of all tile pixels whose candidate x+d lies inside the image
+        int yBegin = max(0, -dy - y0);
+        int yEnd = min(th, srcRow - dy - y0);
+        int xBegin = max(0, -dx - x0);
+        int xEnd = min(tw, srcCol - dx - x0);
+        for (int y = yBegin; y < yEnd; y++)
+        {
+          const double* top = &sat[y*(ew + 1)];
+          const double* bottom = &sat[(y + 2*pr + 1)*(ew + 1)];
+          const float* cand = src.ptr<float>(y0 + y + dy) + x0 + dx;
+          float* r = &res[y*tw];
+          float* zz = &z[y*tw];
+          for (int x = xBegin; x < xEnd; x++)
+          {
+            double dist = bottom[x + 2*pr + 1] - bottom[x] - top[x + 2*pr + 1] + top[x];
+            // compared in double, dist * lutScale exceeds the int range for small sigma;
+            // the integral image may cancel to slightly negative distances
+            double n = max(0., dist) * lutScale;
+            float w = (n < lut.size() - 0.5) ? lut[(int)(n + 0.5)] : 0.f;
+            r[x] += w * cand[x];
+            zz[x] += w;
+          }
         }
       }
-      output.at<float>(i,j) = res/z;
     }
-  }
+
+    for (int y = 0; y < th; y++)
+    {
+      float* out = output.ptr<float>(y0 + y) + x0;
+      for (int x = 0; x < tw; x++)
+      {
+        out[x] = res[y*tw + x] / z[y*tw + x];
+      }
+    }
+  });
 
  return output;
 
@@ -382,6 +1043,184 @@ Mat Dip2::noiseReduction(Mat& src, string method, int kSize, double param){
 
 }
 
+// filter pipeline: parameters of one stage and its line buffers
+struct PipelineStage{
+	// 0 <==> average, 1 <==> median, 2 <==> bilateral
+	int method;
+	int kSize;
+	// taps of output row y are the input rows y-before .. y+after
+	int before, after;
+	// bilateral weights
+	vector<float> spatial, lut;
+	float scale;
+
+	// output rows lo .. hi-1 are computed in the current band, next is the next one
+	int lo, hi, next;
+	// ring of kSize padded input rows, input row n is stored in slot n % kSize
+	vector<float> ring;
+	int stride;
+	// output row and scratch space of the row kernels
+	vector<float> out, scratch;
+	vector<double> colSum;
+};
+
+// passes input row n to stage s of a pipeline; every output row that becomes computable is
+// passed on to the next stage or, for the last stage, written to output
+/*
+stages:  the pipeline
+s:       index of the stage
+n:       index of the input row
+row:     the input row
+output:  output image
+*/
+static void pipelinePush(vector<PipelineStage>& stages, int s, int n, const float* row, Mat& output){
+
+	PipelineStage& st = stages[s];
+	int rows = output.rows;
+	int width = output.cols;
+
+	// store the row with replicated border columns
+	float* slot = &st.ring[(n % st.kSize)*st.stride];
+	for (int x = 0; x < st.before; x++){
+		slot[x] = row[0];
+	}
+	memcpy(slot + st.before, row, width*sizeof(float));
+	for (int x = st.before + width; x < st.stride; x++){
+		slot[x] = row[width - 1];
+	}
+
+	// output row y needs the input rows up to y+after (clamped to the image)
+	const float* win[64];
+	vector<const float*> winHeap;
+	const float** w = win;
+	if (st.kSize > 64){
+		winHeap.resize(st.kSize);
+		w = &winHeap[0];
+	}
+	while ( (st.next < st.hi) && (min(st.next + st.after, rows - 1) <= n) ){
+		int y = st.next;
+		for (int k = 0; k < st.kSize; k++){
+			int r = y - st.before + k;
+			r = r < 0 ? 0 : (r >= rows ? rows - 1 : r);
+			w[k] = &st.ring[(r % st.kSize)*st.stride];
+		}
+
+		float* dst = &st.out[0];
+		switch (st.method){
+			case 0:
+				averageRow(w, width, st.kSize, &st.colSum[0], dst);
+				break;
+			case 1:
+				if (st.kSize == 3){
+					medianNetworkRow<3>(w, width, &st.scratch[0], dst);
+				}else if (st.kSize == 5){
+					medianNetworkRow<5>(w, width, &st.scratch[0], dst);
+				}else{
+					medianRow(w, width, st.kSize, &st.scratch[0], dst);
+				}
+				break;
+			default:
+				bilateralRow(w, width, st.kSize, &st.spatial[0], &st.lut[0], st.scale, dst);
+		}
+
+		if (s + 1 < (int)stages.size()){
+			pipelinePush(stages, s + 1, y, dst, output);
+		}else{
+			memcpy(output.ptr<float>(y), dst, width*sizeof(float));
+		}
+		st.next++;
+	}
+}
+
+// noise reduction by a pipeline of filters
+// the image is processed in bands of rows; inside a band every stage keeps only kSize input
+// rows and one output row, so intermediate results never become full-size images.
+// Borders are replicated by every stage. For the bilateral filter the spatial weight of
+// border taps is taken at the tap offset (noiseReduction("bilateral") uses the clamped position)
+/*
+src:     input image
+stages:  filters in the order they are applied ("average", "median", "bilateral")
+return:  output image
+*/
+Mat Dip2::noiseReduction(Mat& src, vector<FilterStage>& stages){
+
+   vector<PipelineStage> pipeline;
+   for (size_t i = 0; i < stages.size(); i++){
+      PipelineStage st;
+      if (stages[i].method.compare("average") == 0){
+         st.method = 0;
+      }else if (stages[i].method.compare("median") == 0){
+         st.method = 1;
+      }else if (stages[i].method.compare("bilateral") == 0){
+         st.method = 2;
+      }else{
+         cout << "WARNING: Filtering method " << stages[i].method << " can not be used in a pipeline! Stage is skipped" << endl;
+         continue;
+      }
+      st.kSize = stages[i].kSize;
+      st.before = (st.kSize - 1) / 2;
+      st.after = st.kSize - 1 - st.before;
+      if (st.method == 2){
+         // the stages before only average or select values --> the range of src covers all inputs
+         st.scale = bilateralRangeTable(src, stages[i].param, st.lut);
+         int sigmaK = st.kSize/2;
+         st.spatial.resize(st.kSize*st.kSize);
+         for (int k = 0; k < st.kSize; k++){
+            for (int l = 0; l < st.kSize; l++){
+               int d2 = (k - st.before)*(k - st.before) + (l - st.before)*(l - st.before);
+               st.spatial[k*st.kSize + l] = (sigmaK > 0) ? exp( -d2 / (2.*sigmaK*sigmaK) ) : 1;
+            }
+         }
+      }
+      pipeline.push_back(st);
+   }
+   if (pipeline.empty()){
+      return src.clone();
+   }
+
+   int srcRow = src.rows;
+   int srcCol = src.cols;
+   Mat output = Mat::zeros(srcRow, srcCol, CV_32FC1);
+
+   // rows each band has to compute in addition to its own
+   int halo = 0;
+   for (size_t s = 0; s < pipeline.size(); s++){
+      halo += pipeline[s].kSize - 1;
+   }
+   int bandRows = max(64, 8*halo);
+   int numBands = (srcRow + bandRows - 1) / bandRows;
+
+   ThreadPool::instance().parallelFor(numBands, [&](int band){
+
+      vector<PipelineStage> st = pipeline;
+      int S = st.size();
+
+      // output rows of every stage: the last one produces the band, every earlier one
+      // the rows the next stage reads
+      int lo = band*bandRows;
+      int hi = min(srcRow, lo + bandRows);
+      for (int s = S - 1; s >= 0; s--){
+         st[s].lo = lo;
+         st[s].hi = hi;
+         st[s].next = lo;
+         lo = max(0, lo - st[s].before);
+         hi = min(srcRow, hi + st[s].after);
+
+         st[s].stride = srcCol + st[s].kSize + ROW_PAD;
+         st[s].ring.assign(st[s].kSize*st[s].stride, 0.f);
+         st[s].out.assign(srcCol + VLEN, 0.f);
+         st[s].scratch.assign(st[s].kSize*max(st[s].kSize, st[s].stride), 0.f);
+         st[s].colSum.assign(st[s].stride, 0.);
+      }
+
+      for (int n = lo; n < hi; n++){
+         pipelinePush(st, 0, n, src.ptr<float>(n), output);
+      }
+   });
+
+   return output;
+}
+
 // generates and saves different noisy versions of input image
 /*
 fname:   path to input image
@@ -408,27 +1247,17 @@ void Dip2::generateNoisyImages(string fname){
    // generate images with different types of noise
    cout << "generate noisy images" << endl;
 
-   // some temporary images
-   Mat tmp1(img.rows, img.cols, CV_32FC1);
-   Mat tmp2(img.rows, img.cols, CV_32FC1);
+   // counter-based random numbers (fixed seed) --> the same noisy images on every run
+   NoiseGenerator noise;
    // first noise operation
    float noiseLevel = 0.15;
-   randu(tmp1, 0, 1);
-   threshold(tmp1, tmp2, noiseLevel, 1, CV_THRESH_BINARY);
-   multiply(tmp2,img,tmp2);
-   threshold(tmp1, tmp1, 1-noiseLevel, 1, CV_THRESH_BINARY);
-   tmp1 *= 255;
-   tmp1 = tmp2 + tmp1;
-   threshold(tmp1, tmp1, 255, 255, CV_THRESH_TRUNC);
+   Mat tmp1 = noise.impulseNoise(img, noiseLevel, 0);
    // save image
    imwrite("noiseType_1.jpg", tmp1);
     
    // second noise operation
    noiseLevel = 50;
-   randn(tmp1, 0, noiseLevel);
-   tmp1 = img + tmp1;
-   threshold(tmp1,tmp1,255,255,CV_THRESH_TRUNC);
-   threshold(tmp1,tmp1,0,0,CV_THRESH_TOZERO);
+   tmp1 = noise.gaussianNoise(img, noiseLevel, 0);
    // save image
    imwrite("noiseType_2.jpg", tmp1);
 
@@ -437,12 +1266,55 @@ void Dip2::generateNoisyImages(string fname){
 
 }
 
+// generates a dataset of noisy versions of the input image for validation of the filters
+// all images are written uncompressed (binary PGM) to the current directory
+/*
+fname:     path to input image
+numSeeds:  number of different noise realisations per noise level
+*/
+void Dip2::generateNoiseDataset(string fname, int numSeeds){
+
+   // load image, force gray-scale
+   cout << "load original image" << endl;
+   Mat img = imread(fname, 0);
+   if (!img.data){
+      cerr << "ERROR: file " << fname << " not found" << endl;
+      cout << "Press enter to exit"  << endl;
+      cin.get();
+      exit(-3);
+   }
+   img.convertTo(img,CV_32FC1);
+   cout << "done" << endl;
+
+   double impulse[] = {0.02, 0.05, 0.1, 0.15, 0.2, 0.3};
+   double gauss[] = {5, 10, 20, 30, 50, 70};
+   vector<double> impulseLevels(impulse, impulse + sizeof(impulse)/sizeof(double));
+   vector<double> gaussLevels(gauss, gauss + sizeof(gauss)/sizeof(double));
+   vector<unsigned long long> seeds;
+   for (int n = 0; n < numSeeds; n++){
+      seeds.push_back(n);
+   }
+
+   cout << "generate " << (impulseLevels.size() + gaussLevels.size())*seeds.size() << " noisy images" << endl;
+   NoiseGenerator noise;
+   int failed = noise.generateDataset(img, impulseLevels, gaussLevels, seeds, "noise_");
+   if (failed > 0){
+      cerr << "ERROR: " << failed << " images could not be written" << endl;
+   }
+   cout << "done" << endl;
+}
+
 // function calls some basic testing routines to test individual functions for correctness
 void Dip2::test(void){
 
 	test_spatialConvolution();
    test_averageFilter();
    test_medianFilter();
+   test_medianHistogram();
+   test_medianNetwork();
+   test_bilateralFilter();
+   test_nlmFilter();
+   test_noiseReductionPipeline();
 
    cout << "Press enter to continue"  << endl;
    cin.get();
@@ -603,3 +1475,290 @@ void Dip2::test_medianFilter(void){
    cout << "Message: Dip2::medianFilter() seems to be correct" << endl;
 
 }
+
+// random test image
+/*
+rows:     number of rows
+cols:     number of columns
+maxVal:   values are in [0, maxVal)
+integral: round the values down to integers
+seed:     seed of the random numbers
+return:   the image (CV_32FC1)
+*/
+Mat Dip2::randomImage(int rows, int cols, float maxVal, bool integral, uint64 seed){
+
+   RNG rng(seed);
+   Mat img(rows, cols, CV_32FC1);
+   for(int y=0; y<rows; y++){
+      for(int x=0; x<cols; x++){
+         float v = rng.uniform(0.f, maxVal);
+         img.at<float>(y,x) = integral ? floor(v) : v;
+      }
+   }
+   return img;
+}
+
+// median by sorting every (clamped) window, reference for the tests
+/*
+src:     input image
+kSize:   window size used by median operation
+return:  filtered image
+*/
+static Mat sortedMedian(Mat& src, int kSize){
+
+   Mat output(src.rows, src.cols, CV_32FC1);
+   int before = (kSize - 1) / 2;
+   vector<float> tab;
+   for(int y=0; y<src.rows; y++){
+      for(int x=0; x<src.cols; x++){
+         tab.clear();
+         for(int k=-before; k<kSize-before; k++){
+            for(int l=-before; l<kSize-before; l++){
+               int r = min(max(y + k, 0), src.rows - 1);
+               int c = min(max(x + l, 0), src.cols - 1);
+               tab.push_back(src.at<float>(r, c));
+            }
+         }
+         sort(tab.begin(), tab.end());
+         output.at<float>(y,x) = tab[(tab.size() - 1) / 2];
+      }
+   }
+   return output;
+}
+
+// compares the sliding histogram median (integral values, several strips) and the sorting
+// fallback (non-integral values) with sorted windows
+void Dip2::test_medianHistogram(void){
+
+   // wider than one strip of 256 columns
+   Mat input = randomImage(40, 300, 256, true, 1);
+   int sizes[] = {7, 9, 15};
+   for(int i=0; i<3; i++){
+      Mat output = medianFilter(input, sizes[i]);
+      if (norm(output, sortedMedian(input, sizes[i]), NORM_INF) > 0){
+         cout << "ERROR: Dip2::medianHistogram(): Result of a " << sizes[i] << "x" << sizes[i] << " window contains wrong values!" << endl;
+         return;
+      }
+   }
+
+   input = randomImage(30, 45, 255, false, 2);
+   Mat output = medianFilter(input, 7);
+   if (norm(output, sortedMedian(input, 7), NORM_INF) > 0){
+      cout << "ERROR: Dip2::medianFilter(): Result for non-integral values contains wrong values!" << endl;
+      return;
+   }
+   cout << "Message: Dip2::medianHistogram() seems to be correct" << endl;
+}
+
+// compares the sorting networks with sorted windows, border pixels included
+void Dip2::test_medianNetwork(void){
+
+   // width is no multiple of the vector length
+   Mat input = randomImage(23, 37, 255, false, 3);
+   for(int kSize=3; kSize<=5; kSize+=2){
+      Mat output = medianFilter(input, kSize);
+      if (norm(output, sortedMedian(input, kSize), NORM_INF) > 0){
+         cout << "ERROR: Dip2::medianNetwork(): Result of a " << kSize << "x" << kSize << " window contains wrong values!" << endl;
+         return;
+      }
+   }
+   cout << "Message: Dip2::medianNetwork() seems to be correct" << endl;
+}
+
+// bilateral filter evaluated pixel by pixel in double precision, reference for the tests
+/*
+src:     input image
+kSize:   window size of kernel --> used to compute std-dev of spatial kernel
+sigma:   standard-deviation of radiometric kernel
+return:  filtered image
+*/
+static Mat directBilateral(Mat& src, int kSize, double sigma){
+
+   Mat output(src.rows, src.cols, CV_32FC1);
+   double sigmaK = kSize/2;
+   int before = (kSize - 1) / 2;
+   for(int y=0; y<src.rows; y++){
+      for(int x=0; x<src.cols; x++){
+         double center = src.at<float>(y,x);
+         double res = 0, z = 0;
+         for(int k=-before; k<kSize-before; k++){
+            for(int l=-before; l<kSize-before; l++){
+               // the spatial weight uses the clamped position
+               int r = min(max(y + k, 0), src.rows - 1);
+               int c = min(max(x + l, 0), src.cols - 1);
+               double v = src.at<float>(r, c);
+               double d2 = (r - y)*(r - y) + (c - x)*(c - x);
+               double h = exp(-d2 / (2*sigmaK*sigmaK)) * exp(-(v - center)*(v - center) / (2*sigma*sigma));
+               res += h * v;
+               z += h;
+            }
+         }
+         output.at<float>(y,x) = res / z;
+      }
+   }
+   return output;
+}
+
+// compares the table based SIMD bilateral filter with the direct computation
+// on grey values (exact table entries) and on a wide value range (scaled table)
+void Dip2::test_bilateralFilter(void){
+
+   // width is no multiple of the vector length, border bands on all sides
+   Mat input = randomImage(29, 45, 256, true, 4);
+   Mat output = bilateralFilter(input, 5, 20);
+   if (output.size() != input.size()){
+      cout << "ERROR: Dip2::bilateralFilter(): input.size != output.size --> Wrong border handling?" << endl;
+      return;
+   }
+   if (norm(output, directBilateral(input, 5, 20), NORM_INF) > 0.01){
+      cout << "ERROR: Dip2::bilateralFilter(): Result for grey values contains wrong values!" << endl;
+      return;
+   }
+
+   // range * 16 > 65536 --> coarser table
+   input = randomImage(29, 45, 100000, false, 5);
+   output = bilateralFilter(input, 7, 20000);
+   if (norm(output, directBilateral(input, 7, 20000), NORM_INF) > 1){
+      cout << "ERROR: Dip2::bilateralFilter(): Result for a wide value range contains wrong values!" << endl;
+      return;
+   }
+   cout << "Message: Dip2::bilateralFilter() seems to be correct" << endl;
+}
+
+// non-local means with the patch distances summed pixel by pixel, reference for the tests
+/*
+src:        input image
+searchSize: size of search region
+sigma:      parameter of the weighting function, sigma <= 0 weights all candidates equally
+patchSize:  size of compared patches
+return:     filtered image
+*/
+static Mat directNlm(Mat& src, int searchSize, double sigma, int patchSize){
+
+   Mat output(src.rows, src.cols, CV_32FC1);
+   int searchBefore = (searchSize - 1) / 2;
+   int pr = patchSize / 2;
+   int patchArea = (2*pr + 1)*(2*pr + 1);
+   for(int y=0; y<src.rows; y++){
+      for(int x=0; x<src.cols; x++){
+         double res = 0, z = 0;
+         for(int dy=-searchBefore; dy<searchSize-searchBefore; dy++){
+            for(int dx=-searchBefore; dx<searchSize-searchBefore; dx++){
+               // only candidates inside of the image, patches are clamped
+               if ( (y + dy < 0) || (y + dy >= src.rows) || (x + dx < 0) || (x + dx >= src.cols) ){
+                  continue;
+               }
+               double dist = 0;
+               for(int k=-pr; k<=pr; k++){
+                  for(int l=-pr; l<=pr; l++){
+                     double diff = src.at<float>(min(max(y + k, 0), src.rows - 1), min(max(x + l, 0), src.cols - 1))
+                                 - src.at<float>(min(max(y + k + dy, 0), src.rows - 1), min(max(x + l + dx, 0), src.cols - 1));
+                     dist += diff*diff;
+                  }
+               }
+               double w = (sigma > 0) ? exp(-dist / (sigma*sigma*patchArea)) : 1;
+               res += w * src.at<float>(y + dy, x + dx);
+               z += w;
+            }
+         }
+         output.at<float>(y,x) = res / z;
+      }
+   }
+   return output;
+}
+
+// compares the integral image based non-local means with directly summed patch distances,
+// also for a tiny sigma (only the pixel itself gets a weight) and sigma <= 0 (plain mean)
+void Dip2::test_nlmFilter(void){
+
+   Mat input = randomImage(21, 70, 256, true, 6);
+   Mat output = nlmFilter(input, 7, 40, 5);
+   if (output.size() != input.size()){
+      cout << "ERROR: Dip2::nlmFilter(): input.size != output.size --> Wrong border handling?" << endl;
+      return;
+   }
+   if (norm(output, directNlm(input, 7, 40, 5), NORM_INF) > 0.5){
+      cout << "ERROR: Dip2::nlmFilter(): Result contains wrong values!" << endl;
+      return;
+   }
+
+   output = nlmFilter(input, 7, 0.01, 5);
+   if (norm(output, input, NORM_INF) > 0.0001){
+      cout << "ERROR: Dip2::nlmFilter(): Result for a tiny sigma differs from the input!" << endl;
+      return;
+   }
+
+   output = nlmFilter(input, 5, 0, 3);
+   if (norm(output, directNlm(input, 5, 0, 3), NORM_INF) > 0.001){
+      cout << "ERROR: Dip2::nlmFilter(): Result for sigma <= 0 is no mean of the search region!" << endl;
+      return;
+   }
+   cout << "Message: Dip2::nlmFilter() seems to be correct" << endl;
+}
+
+// compares the fused pipeline with the stages applied one after another
+void Dip2::test_noiseReductionPipeline(void){
+
+   // the height is no multiple of the band height
+   Mat input = randomImage(150, 77, 256, true, 7);
+
+   const int numChains = 4;
+   FilterStage chains[numChains][3] = {
+      {{"average", 3, 0}, {"", 0, 0}, {"", 0, 0}},
+      {{"median", 3, 0}, {"average", 5, 0}, {"", 0, 0}},
+      {{"average", 3, 0}, {"median", 7, 0}, {"median", 5, 0}},
+      {{"median", 5, 0}, {"average", 3, 0}, {"bilateral", 5, 30}}
+   };
+   int lengths[numChains] = {1, 2, 3, 3};
+
+   for(int c=0; c<numChains; c++){
+      vector<FilterStage> stages(chains[c], chains[c] + lengths[c]);
+      Mat output = noiseReduction(input, stages);
+      Mat ref = input;
+      for(size_t s=0; s<stages.size(); s++){
+         ref = noiseReduction(ref, stages[s].method, stages[s].kSize, stages[s].param);
+      }
+      if (output.size() != input.size()){
+         cout << "ERROR: Dip2::noiseReduction(): pipeline result has wrong size!" << endl;
+         return;
+      }
+      // the pipeline weights bilateral border taps by their offset, compared inside only
+      Rect inner(0, 0, input.cols, input.rows);
+      if (stages.back().method.compare("bilateral") == 0){
+         int border = stages.back().kSize / 2;
+         inner = Rect(border, border, input.cols - 2*border, input.rows - 2*border);
+      }
+      if (norm(output(inner), ref(inner), NORM_INF) > 0.001){
+         cout << "ERROR: Dip2::noiseReduction(): pipeline " << c << " differs from the filters applied one after another!" << endl;
+         return;
+      }
+   }
+
+   // the pipeline weights bilateral border taps by their offset, so the border has to differ
+   vector<FilterStage> bilateral(1, chains[3][2]);
+   Mat output = noiseReduction(input, bilateral);
+   Mat ref = bilateralFilter(input, 5, 30);
+   if (norm(output.row(0), ref.row(0), NORM_INF) == 0){
+      cout << "ERROR: Dip2::noiseReduction(): bilateral border of the pipeline equals the single filter, see documentation!" << endl;
+      return;
+   }
+
+   // stages that can not run in a pipeline are skipped with a warning
+   vector<FilterStage> withNlm(chains[1], chains[1] + 2);
+   FilterStage nlm = {"nlm", 5, 10};
+   withNlm.insert(withNlm.begin() + 1, nlm);
+   ostringstream messages;
+   streambuf* coutBuf = cout.rdbuf(messages.rdbuf());
+   output = noiseReduction(input, withNlm);
+   cout.rdbuf(coutBuf);
+   vector<FilterStage> withoutNlm(chains[1], chains[1] + 2);
+   if (messages.str().find("WARNING") == string::npos){
+      cout << "ERROR: Dip2::noiseReduction(): no warning for the nlm stage!" << endl;
+      return;
+   }
+   if (norm(output, noiseReduction(input, withoutNlm), NORM_INF) > 0){
+      cout << "ERROR: Dip2::noiseReduction(): nlm stage was not skipped!" << endl;
+      return;
+   }
+   cout << "Message: Dip2::noiseReduction() pipeline seems to be correct" << endl;
+}
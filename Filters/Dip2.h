@@ -12,8 +12,21 @@
 using namespace std;
 using namespace cv;
 
+// one stage of a filter pipeline, see Dip2::noiseReduction(Mat&, vector<FilterStage>&)
+struct FilterStage{
+   // "average", "median" or "bilateral"
+   string method;
+   // (spatial) kernel size
+   int kSize;
+   // standard-deviation of radiometric kernel if method == "bilateral"
+   double param;
+};
+
 class Dip2{
 
+   // the benchmark suite times the processing routines directly
+   friend class Benchmark;
+
    public:
       // constructor
       Dip2(void){};
@@ -23,10 +36,14 @@ class Dip2{
       // processing routines
       // to create noise images
       void generateNoisyImages(string);
+      // to create a dataset of noisy images (all levels, numSeeds realisations each)
+      void generateNoiseDataset(string fname, int numSeeds);
       // for noise suppression
       void run(void);
       // testing routine
       void test(void);
+      // applies several filters one after another in a single pass over the image
+      Mat noiseReduction(Mat& src, vector<FilterStage>& stages);
 
    private:
       // function headers of functions to be implemented
@@ -40,7 +57,14 @@ class Dip2{
       // bilateral filer
       Mat bilateralFilter(Mat& src, int kSize, double sigma);
       // non-local means filter
-      Mat nlmFilter(Mat& src, int searchSize, double sigma);
+      Mat nlmFilter(Mat& src, int searchSize, double sigma, int patchSize=7);
+
+      // median filter helpers: sorting networks / 8-bit conversion / sliding histogram median
+      Mat medianNetwork(Mat& src, int kSize);
+      bool quantize8U(Mat& src, Mat& dst);
+      Mat medianHistogram(Mat& src, int kSize);
+      // clamps an index to the image (replicated border)
+      int clampIndex(int idx, int size);
 
       // function headers of given functions
       // performs noise reduction
@@ -50,4 +74,11 @@ class Dip2{
       void test_spatialConvolution(void);
       void test_averageFilter(void);
       void test_medianFilter(void);
+      void test_medianHistogram(void);
+      void test_medianNetwork(void);
+      void test_bilateralFilter(void);
+      void test_nlmFilter(void);
+      void test_noiseReductionPipeline(void);
+      // random test image with values in [0, maxVal), integral values if integral is true
+      Mat randomImage(int rows, int cols, float maxVal, bool integral, uint64 seed);
 };
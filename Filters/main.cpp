@@ -13,13 +13,14 @@
 using namespace std;
 
 // usage: argv[1] == "generate" to generate noisy images, path to original image in argv[2]
+// 	    argv[1] == "dataset" to generate noisy images for many noise levels and seeds, path to original image in argv[2]
 // 	    argv[1] == "restorate" to load and restorate noisy images
 // main function. only calls processing and test routines
 int main(int argc, char** argv) {
 
    // check if enough arguments are defined
    if (argc < 2){
-      cout << "Usage:\n\tdip2 generate path_to_original\n\tdip2 restorate"  << endl;
+      cout << "Usage:\n\tdip2 generate path_to_original\n\tdip2 dataset path_to_original [num_seeds]\n\tdip2 restorate"  << endl;
       cout << "Press enter to exit"  << endl;
       cin.get();
       return -1;
@@ -42,6 +43,20 @@ int main(int argc, char** argv) {
       dip2.generateNoisyImages(fname);
    }	
 
+   // alternatively generate a whole dataset of noisy images
+   // path of original image is in argv[2], number of seeds (optional) in argv[3]
+   if (strcmp(argv[1], "dataset") == 0){
+      if (argc < 3){
+         cout << "ERROR: original image not specified"  << endl;
+         cout << "Press enter to exit"  << endl;
+         cin.get();
+         return -2;
+      }
+      string fname = argv[2];
+      int numSeeds = (argc > 3) ? atoi(argv[3]) : 10;
+      dip2.generateNoiseDataset(fname, numSeeds);
+   }
+
    // in a second step try to restorate noisy images
    if (strcmp(argv[1], "restorate") == 0){
       // run some test routines
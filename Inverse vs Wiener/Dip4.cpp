@@ -8,57 +8,49 @@
 
 #include "Dip4.h"
 
+#include "../Common/BoundedQueue.h"
+#include "../Common/NoiseGenerator.h"
+#include "../Common/RestorationContext.h"
+#include "../Common/Spectral.h"
+#include "../Common/ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <thread>
+
+// frequencies of the inverse filter with magnitude below INVERSE_EPSILON * max|H| are
+// replaced by 1/(INVERSE_EPSILON * max|H|)
+static const double INVERSE_EPSILON = 0.05;
+
+// cuts the values of a restorated image to the range of grey values [0,255]
+/*
+img      :  image, changed in place
+*/
+void Dip4::cutRange(Mat& img){
+
+   threshold(img, img, 255, 255, CV_THRESH_TRUNC);
+   threshold(img, img, 0, 0, CV_THRESH_TOZERO);
+}
+
 // Performes a circular shift in (dx,dy) direction
+// whole row blocks are copied instead of single elements
 /*
 in       :  input matrix
 dx       :  shift in x-direction
 dy       :  shift in y-direction
 return   :  circular shifted matrix
 */
-
-
 Mat Dip4::circShift(Mat& in, int dx, int dy){
-int row = in.rows;
-  int col = in.cols;
-
-  Mat output = Mat::zeros(row, col, CV_32FC1);
-
-  for (int i = 0; i < row ; i ++)
-  {
-    for (int j = 0 ; j < col ; j ++)
-    {
-      float x = i + dx;
-      float y = j + dy; 
-
-      if (x < 0)
-      {
-        x = x + row;
-      }
-      if (x >= row) // as dx = -in.row/2 this case won't probably happen...
-      {
-        x = x - row ; 
-      }
-      if (y < 0)
-      {
-        y = y + col;
-      }
-      if (x >= col)
-      {
-        x = x - col ; 
-      }
-
-      output.at<float>(x,y) = in.at<float>(i,j);
 
-    }
-  }
-
-   return output;
+   return Spectral::circShift(in, dx, dy);
 }
 
-
-
-
 // Function applies inverse filter to restorate a degraded image
+// filtering is done on packed real spectra of the padded image (border policy see setBorderType()),
+// the filter spectrum is cached over calls
 /*
 degraded :  degraded input image
 filter   :  filter which caused degradation
@@ -66,121 +58,16 @@ return   :  restorated output image
 */
 Mat Dip4::inverseFilter(Mat& degraded, Mat& filter){
 
+  Spectral spectral(borderType);
+  Mat restorated = spectral.inverseFilter(degraded, filter, INVERSE_EPSILON);
 
-  // Creation of a shifted filter with degraded image size
-
-  int d_row = degraded.rows; 
-  int d_col = degraded.cols; 
-
-  Mat filter_resize = Mat::zeros(d_row, d_col, CV_32FC1); 
-
-  for (int i = 0 ; i < filter.rows ; i ++)
-  {
-    for (int j = 0 ; j < filter.cols ; j++)
-    {
-      filter_resize.at<float>(i,j) = filter.at<float>(i,j); 
-    }
-  }
-
-
- filter_resize = circShift(filter_resize, -filter.rows/2, -filter.cols/2);
-
-
-  // Fourier transform of the degraded image and of the (resized and shifted) filter
-
-  Mat degraded_ft; 
-  Mat filter_ft; 
-
-  dft(degraded, degraded_ft, DFT_COMPLEX_OUTPUT);
-  dft(filter_resize, filter_ft,  DFT_COMPLEX_OUTPUT);
-
-  // Separation of real and imaginary part of the filter in frequency domain
-
-  Mat complexChannel[2];
-  split(filter_ft, complexChannel);
-
-  Mat Re = complexChannel[0];
-  Mat Im = complexChannel[1]; 
-
-  // calculation of the threshold
-
-  float epsilon = 0.05; 
-
-  int row = filter_ft.rows;
-  int col = filter_ft.cols;
-
-  float max = 0; 
-
-  for (int i = 0 ; i < row; i ++)
-  {
-    for (int j = 0 ; j < col ; j ++)
-    {
-      if (sqrt(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2)) > max) 
-      {
-        max = sqrt(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2));
-      }
-    }
-  }
-
-
-   float T = epsilon * max;  
-
- // Creation of Q
-
-  for (int i = 0 ; i < row; i ++)
-  {
-    for (int j = 0 ; j < col ; j ++)
-    {
-      if (sqrt(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2)) > T)
-      {
-        Re.at<float>(i,j) = Re.at<float>(i,j)/(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2));
-        Im.at<float>(i,j) = -Im.at<float>(i,j)/(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2));
-      }
-      else 
-      {
-        Re.at<float>(i,j) = 1/T;
-        Im.at<float>(i,j) = 0; 
-      }
-    }
-  }
-
-
-  vector<Mat> complexChannel_inverse;
-
-  complexChannel_inverse.push_back(Re); 
-  complexChannel_inverse.push_back(Im); 
-
-  Mat Q = Mat::zeros(Re.rows, Re.cols, CV_32F); 
-
-  merge(complexChannel_inverse,Q);
-
-
-  // Multiplication of the inverse filter
-
-  Mat restorated_ft;
-
-  mulSpectrums(degraded_ft, Q, restorated_ft, 1); 
-
-  // Creation of the restorated image
-
-  Mat restorated; 
-
-
-  dft(restorated_ft, restorated, CV_DXT_INV_SCALE);
-
-  // Take only the real part of the restorated image - after the inverse fourier transform
-  split(restorated, complexChannel);
-  restorated = complexChannel[0];
-
-  //Threshold the restorated image (values between 0 and 255)
-  threshold(restorated, restorated, 255, 255, CV_THRESH_TRUNC);
-  threshold(restorated, restorated, 0, 0, CV_THRESH_TOZERO);
-
+  cutRange(restorated);
 
    return restorated;
 }
 
 // Function applies wiener filter to restorate a degraded image
+// Q = conj(H) / (|H|^2 + 1/snr^2), applied directly on the packed spectra
 /*
 degraded :  degraded input image
 filter   :  filter which caused degradation
@@ -188,131 +75,463 @@ snr      :  signal to noise ratio of the input image
 return   :   restorated output image
 */
 Mat Dip4::wienerFilter(Mat& degraded, Mat& filter, double snr){
-	
-  // Creation of a shifted filter with degraded image size
 
-  int d_row = degraded.rows; 
-  int d_col = degraded.cols; 
+  Spectral spectral(borderType);
+  Mat restorated = spectral.wienerFilter(degraded, filter, snr);
 
-  Mat filter_resize = Mat::zeros(d_row, d_col, CV_32FC1); 
+  cutRange(restorated);
 
-  for (int i = 0 ; i < filter.rows ; i ++)
-  {
-    for (int j = 0 ; j < filter.cols ; j++)
-    {
-      filter_resize.at<float>(i,j) = filter.at<float>(i,j); 
-    }
-  }
+   return restorated;
+}
 
-  filter_resize = circShift(filter_resize, -filter.rows/2, -filter.cols/2);
+/* *****************************
+  GIVEN FUNCTIONS
+***************************** */
 
-  // Fourier transform of the degraded image and of the (resized and shifted) filter
+// function calls processing function
+/*
+in                   :  input image
+restorationType     :  integer defining which restoration function is used
+kernel               :  kernel used during restoration
+snr                  :  signal-to-noise ratio (only used by wieder filter)
+return               :  restorated image
+*/
+Mat Dip4::run(Mat& in, string restorationType, Mat& kernel, double snr){
 
-  Mat degraded_ft; 
-  Mat filter_ft; 
+   if (restorationType.compare("wiener")==0){
+      return wienerFilter(in, kernel, snr);
+   }else{
+      return inverseFilter(in, kernel);
+   }
 
-  dft(degraded, degraded_ft, DFT_COMPLEX_OUTPUT);
-  dft(filter_resize, filter_ft,  DFT_COMPLEX_OUTPUT);
+}
 
-  // Separation of real and imaginary part of the filter in frequency domain
+// function restores a batch of images
+// the filter spectrum is computed once per image size (see RestorationContext), then every
+// image costs one forward and one inverse transform; the images are restored in parallel
+/*
+in                   :  input images
+restorationType      :  "wiener" or "inverse"
+kernel               :  kernel used during restoration
+snr                  :  signal-to-noise ratio (only used by wieder filter)
+return               :  restorated images in the order of in
+*/
+vector<Mat> Dip4::runBatch(vector<Mat>& in, string restorationType, Mat& kernel, double snr){
+
+   bool wiener = (restorationType.compare("wiener")==0);
+   int type = wiener ? RESTORE_WIENER : RESTORE_INVERSE;
+   double param = wiener ? snr : INVERSE_EPSILON;
+
+   // one context per image size, built before the parallel part
+   vector<RestorationContext> contexts;
+   map<pair<int, int>, int> index;
+   vector<int> context(in.size());
+   for(size_t i = 0; i < in.size(); i++){
+      pair<int, int> key(in[i].rows, in[i].cols);
+      if (index.find(key) == index.end()){
+         index[key] = (int)contexts.size();
+         contexts.push_back(RestorationContext(kernel, in[i].size(), type, param, borderType));
+      }
+      context[i] = index[key];
+   }
 
-  Mat complexChannel[2];
-  split(filter_ft, complexChannel);
+   vector<Mat> restored(in.size());
+   ThreadPool::instance().parallelFor((int)in.size(), [&](int i){
+      Mat restorated = contexts[context[i]].apply(in[i]);
 
-  Mat Re = complexChannel[0];
-  Mat Im = complexChannel[1]; 
+      cutRange(restorated);
+      restored[i] = restorated;
+   });
 
-  // calculation of the threshold
+   return restored;
+}
 
-  float epsilon = 0.05; 
+// function restores an image with the wiener filter for a sweep of signal to noise ratios
+// the image and kernel are transformed once, every ratio costs a division pass and an inverse transform
+/*
+in          :  input image
+kernel      :  kernel used during restoration
+snrs        :  signal-to-noise ratios to try
+scores      :  PSNR in dB of each restoration against reference (empty without reference)
+reference   :  undegraded image, optional
+parallel    :  restore for all ratios in parallel
+return      :  restorated image per ratio, in the order of snrs
+*/
+vector<Mat> Dip4::runSweep(Mat& in, Mat& kernel, const vector<double>& snrs, vector<double>& scores,
+                           Mat reference, bool parallel){
 
-  int row = filter_ft.rows;
-  int col = filter_ft.cols;
+   Spectral spectral(borderType);
+   vector<Mat> restored = spectral.wienerSweep(in, kernel, snrs, parallel);
 
-  float max = 0; 
+   scores.clear();
+   for(size_t i = 0; i < restored.size(); i++){
+      cutRange(restored[i]);
 
-  for (int i = 0 ; i < row; i ++)
-  {
-    for (int j = 0 ; j < col ; j++)
-    {
-      if (sqrt(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2)) > max) 
-      {
-        max = sqrt(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2));
+      if (!reference.empty()){
+         double l2 = norm(restored[i], reference, NORM_L2);
+         double mse = l2 * l2 / restored[i].total();
+         scores.push_back(10 * log10(255. * 255. / max(mse, 1e-10)));
       }
-    }
-  }
-
-   float T = epsilon * max; 
- 
- 
- // Creation of Q
-
-  for (int i = 0 ; i < row; i ++)
-  {
-    for (int j = 0 ; j < col ; j++)
-    {
-        Re.at<float>(i,j) = Re.at<float>(i,j)/(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2) + 1/pow(snr,2));
-        Im.at<float>(i,j) = -Im.at<float>(i,j)/(pow(Re.at<float>(i,j),2) + pow(Im.at<float>(i,j),2) + 1/pow(snr,2));
-    }
-  }
+   }
 
+   return restored;
+}
 
-  vector<Mat> complexChannel_inverse;
+// a frame on its way through the streaming pipeline
+// frames are passed back to the decoder after encoding, so their buffers are reused
+struct StreamFrame{
+   int index;
+   Mat image;       // decoded grey values (CV_32FC1)
+   Mat restored;    // restoration result (CV_32FC1)
+};
+
+// frames between two progress reports of runStream()
+static const int STREAM_REPORT_FRAMES = 100;
+
+// function restores a video stream
+// three stages connected by bounded queues: decoding (one thread), restoration (workers threads,
+// each with its own recycled transform buffers, sharing one filter spectrum) and encoding (calling
+// thread, writes the frames in their original order). All frames come from a fixed pool: the
+// decoder waits for a frame the encoder has written, so the frames in the queues, in the
+// workers and those waiting to be written in order never exceed the pool size. This cannot
+// deadlock, frames are decoded in order and the next frame to write is always decoded already
+/*
+source            :  video file or image sequence (printf pattern) to read
+target            :  video file (MJPG) or image sequence (printf pattern) to write
+restorationType   :  "wiener" or "inverse"
+kernel            :  kernel used during restoration
+snr               :  signal-to-noise ratio (only used by wiener filter)
+workers           :  number of restoration threads, <= 0 chooses by the number of cores
+queueSize         :  capacity of the queues between the stages
+return            :  frames per second over the whole stream, 0 on failure
+*/
+double Dip4::runStream(const string& source, const string& target, string restorationType, Mat& kernel,
+                       double snr, int workers, int queueSize){
+
+   VideoCapture capture(source);
+   Mat raw;
+   if (!capture.isOpened() || !capture.read(raw) || raw.empty()){
+      cerr << "ERROR: Dip4::runStream(): cannot read frames from " << source << endl;
+      return 0;
+   }
 
-  complexChannel_inverse.push_back(Re); 
-  complexChannel_inverse.push_back(Im); 
+   // the first frame fixes the size of all frames
+   Size size = raw.size();
+   bool sequence = (target.find('%') != string::npos);
+   VideoWriter writer;
+   if (!sequence){
+      double fps = capture.get(CAP_PROP_FPS);
+      writer.open(target, VideoWriter::fourcc('M','J','P','G'), (fps > 0) ? fps : 25, size, false);
+      if (!writer.isOpened()){
+         cerr << "ERROR: Dip4::runStream(): cannot write " << target << endl;
+         return 0;
+      }
+   }
 
-  Mat Q = Mat::zeros(Re.rows, Re.cols, CV_32F); 
+   bool wiener = (restorationType.compare("wiener")==0);
+   RestorationContext context(kernel, size, wiener ? RESTORE_WIENER : RESTORE_INVERSE,
+                              wiener ? snr : INVERSE_EPSILON, borderType);
 
-  merge(complexChannel_inverse,Q);
+   if (workers <= 0){
+      workers = max(1, (int)thread::hardware_concurrency() - 2);
+   }
+   BoundedQueue<StreamFrame> decoded(queueSize);
+   BoundedQueue<StreamFrame> restored(queueSize);
+   // enough frames to fill both queues and keep every stage thread busy
+   int poolSize = 2 * queueSize + workers + 2;
+   BoundedQueue<StreamFrame> recycled(poolSize);
+   for(int p = 0; p < poolSize; p++){
+      StreamFrame frame;
+      frame.image.create(size, CV_32FC1);
+      frame.restored.create(size, CV_32FC1);
+      recycled.push(frame);
+   }
 
+   int64 start = getTickCount();
+
+   thread decoder([&](){
+      int index = 0;
+      Mat gray;
+      do{
+         if (raw.size() != size){
+            cerr << "ERROR: Dip4::runStream(): frame " << index << " has a different size, stream cut" << endl;
+            break;
+         }
+         if (raw.channels() == 3){
+            cvtColor(raw, gray, COLOR_BGR2GRAY);
+         }else{
+            gray = raw;
+         }
+         StreamFrame frame;
+         if (!recycled.pop(frame)){
+            break;
+         }
+         frame.index = index++;
+         gray.convertTo(frame.image, CV_32FC1);
+         if (!decoded.push(frame)){
+            break;
+         }
+      }while(capture.read(raw) && !raw.empty());
+      decoded.close();
+   });
+
+   atomic<int> running(workers);
+   vector<thread> restorers;
+   for(int w = 0; w < workers; w++){
+      restorers.push_back(thread([&](){
+         RestorationContext::Buffers buffers;
+         StreamFrame frame;
+         while (decoded.pop(frame)){
+            context.apply(frame.image, frame.restored, buffers);
+
+            cutRange(frame.restored);
+            restored.push(frame);
+         }
+         if (--running == 0){
+            restored.close();
+         }
+      }));
+   }
 
-  // Multiplication of the inverse filter
+   // encoding, frames finished out of order wait in pending
+   // a frame that cannot be written closes all queues, the other stages stop after their current frame
+   map<int, StreamFrame> pending;
+   int next = 0;
+   int64 lastReport = start;
+   bool failed = false;
+   Mat out;
+   StreamFrame frame;
+   while (!failed && restored.pop(frame)){
+      pending[frame.index] = frame;
+      while (pending.count(next)){
+         StreamFrame& done = pending[next];
+         done.restored.convertTo(out, CV_8UC1);
+         if (sequence){
+            char name[1024];
+            snprintf(name, sizeof(name), target.c_str(), next);
+            failed = !imwrite(name, out);
+         }else{
+            failed = !writer.isOpened();
+            if (!failed){
+               writer.write(out);
+            }
+         }
+         if (failed){
+            cerr << "ERROR: Dip4::runStream(): cannot write frame " << next << " to " << target << endl;
+            decoded.close();
+            restored.close();
+            recycled.close();
+            break;
+         }
+         recycled.push(done);
+         pending.erase(next);
+         next++;
+
+         if (next % STREAM_REPORT_FRAMES == 0){
+            int64 now = getTickCount();
+            clog << "Dip4::runStream(): " << next << " frames, "
+                 << STREAM_REPORT_FRAMES / ((now - lastReport) / getTickFrequency()) << " frames per second" << endl;
+            lastReport = now;
+         }
+      }
+   }
 
-  Mat restorated_ft;
+   decoder.join();
+   for(size_t w = 0; w < restorers.size(); w++){
+      restorers[w].join();
+   }
+   if (failed){
+      return 0;
+   }
 
-  mulSpectrums(degraded_ft, Q, restorated_ft, 1); 
+   double seconds = (getTickCount() - start) / getTickFrequency();
+   double fps = next / max(seconds, 1e-9);
+   cout << "Message: Dip4::runStream(): " << next << " frames in " << seconds << " s, "
+        << fps << " frames per second" << endl;
+   return fps;
+}
 
-  // Creation of the restorated image
+// sum of the absolute values of the restoration filter that may fall outside of the tile halo
+// (times the grey values this bounds the error of a tile, in practice it stays far below)
+static const double TILE_SUPPORT_TOLERANCE = 0.1;
+
+// function restores an image degraded by a spatially varying kernel
+// the image is covered by tiles of tileSize x tileSize pixels that overlap by half of their size,
+// starting half a tile before the image so that every pixel lies in exactly two tiles per direction.
+// Each tile is restored with the kernel of the grid region of its center, multiplied by a separable
+// sin^2 window and added to the result; the windows of overlapping tiles add up to one.
+// A tile is restored together with a halo of the image around it (outside of the image read with
+// the border policy, see setBorderType()); the restoration filter reaches as far as its support,
+// so with a halo of that size the tile equals the restoration of the whole image. The region is
+// mirrored at its borders for the transform, its own edges must not be joined like a period.
+// Tiles of equal index parity do not overlap, so the four parity classes run one after another,
+// the tiles of a class in parallel. Besides input and result only a few buffers of the size of a
+// tile and its halo per thread are needed. If the halo of a tile would cover the whole image
+// (e.g. wiener filter with a high snr, its support is the whole image), every kernel restores
+// the whole image once instead and the tiles are cut out of it
+/*
+in                   :  input image
+restorationType      :  "wiener" or "inverse"
+psfs                 :  gridRows x gridCols kernels, row by row
+gridRows             :  number of kernel regions along the image rows
+gridCols             :  number of kernel regions along the image columns
+snr                  :  signal-to-noise ratio (only used by wiener filter)
+tileSize             :  width and height of the tiles (even, the step is tileSize/2)
+halo                 :  pixels restored around every tile, < 0: support of the restoration filters
+return               :  restorated image
+*/
+Mat Dip4::runTiled(Mat& in, string restorationType, vector<Mat>& psfs, int gridRows, int gridCols,
+                   double snr, int tileSize, int halo){
 
-  Mat restorated; 
+   if (gridRows < 1 || gridCols < 1 || (int)psfs.size() != gridRows * gridCols){
+      cerr << "ERROR: Dip4::runTiled(): " << psfs.size() << " kernels given for a "
+           << gridRows << " x " << gridCols << " grid" << endl;
+      return Mat();
+   }
 
+   bool wiener = (restorationType.compare("wiener")==0);
+   int type = wiener ? RESTORE_WIENER : RESTORE_INVERSE;
+   double param = wiener ? snr : INVERSE_EPSILON;
+
+   // grid entries sharing their kernel are restored once
+   vector<int> first(psfs.size());
+   for(size_t p = 0; p < psfs.size(); p++){
+      first[p] = p;
+      for(size_t q = 0; q < p; q++){
+         if (psfs[q].data == psfs[p].data && psfs[q].size() == psfs[p].size()){
+            first[p] = first[q];
+            break;
+         }
+      }
+   }
 
-  dft(restorated_ft, restorated, CV_DXT_INV_SCALE);
+   if (halo < 0){
+      // support of the filters, the transform of twice the image size keeps the periodic
+      // impulse response from folding back onto the radii up to the image size
+      int n = getOptimalDFTSize(2 * max(in.rows, in.cols));
+      halo = 0;
+      for(size_t p = 0; p < psfs.size(); p++){
+         if (first[p] == (int)p){
+            RestorationContext context(psfs[p], Size(n, n), type, param, BORDER_WRAP);
+            halo = max(halo, context.support(TILE_SUPPORT_TOLERANCE));
+         }
+      }
+   }
 
-  // Take only the real part of the restorated image - after the inverse fourier transform
-  split(restorated, complexChannel);
-  restorated = complexChannel[0];
+   tileSize = max(tileSize, 2) & ~1;
+   int step = tileSize / 2;
 
-  //Threshold the restorated image (values between 0 and 255)
-  threshold(restorated, restorated, 255, 255, CV_THRESH_TRUNC);
-  threshold(restorated, restorated, 0, 0, CV_THRESH_TOZERO);
+   // periodic sin^2 window, window[t] + window[t + step] = 1
+   vector<float> window(tileSize);
+   for(int t = 0; t < tileSize; t++){
+      double s = sin(M_PI * (t + 0.5) / tileSize);
+      window[t] = (float)(s * s);
+   }
 
+   int tilesY = (in.rows + step - 1) / step + 1;
+   int tilesX = (in.cols + step - 1) / step + 1;
+   Mat restorated = Mat::zeros(in.rows, in.cols, CV_32FC1);
+
+   // kernel of the grid region of the tile center
+   auto tileKernel = [&](int ty, int tx){
+      int gy = min(gridRows - 1, max(0, ty * step * gridRows / in.rows));
+      int gx = min(gridCols - 1, max(0, tx * step * gridCols / in.cols));
+      return first[gy * gridCols + gx];
+   };
+
+   // adds the windowed part of tile (ty,tx) inside of the image, source holds the pixel (y,x)
+   // of the image at (y - origin.y, x - origin.x)
+   auto blend = [&](int ty, int tx, const Mat& source, Point origin){
+      int y0 = ty * step - step;
+      int x0 = tx * step - step;
+      int yBegin = max(0, y0), yEnd = min(in.rows, y0 + tileSize);
+      int xBegin = max(0, x0), xEnd = min(in.cols, x0 + tileSize);
+      for(int y = yBegin; y < yEnd; y++){
+         const float* r = source.ptr<float>(y - origin.y) - origin.x;
+         float* out = restorated.ptr<float>(y);
+         float wy = window[y - y0];
+         for(int x = xBegin; x < xEnd; x++){
+            out[x] += wy * window[x - x0] * r[x];
+         }
+      }
+   };
+
+   // runs process(ty, tx) for all tiles, tiles of one parity class in parallel
+   auto forEachTile = [&](const function<void(int, int)>& process){
+      for(int parity = 0; parity < 4; parity++){
+         int py = parity / 2;
+         int px = parity % 2;
+         int countY = (tilesY - py + 1) / 2;
+         int countX = (tilesX - px + 1) / 2;
+         ThreadPool::instance().parallelFor(countY * countX, [&](int t){
+            process(py + 2 * (t / countX), px + 2 * (t % countX));
+         });
+      }
+   };
+
+   if (tileSize + 2 * halo >= in.rows && tileSize + 2 * halo >= in.cols){
+      Spectral spectral(borderType);
+      for(size_t p = 0; p < psfs.size(); p++){
+         if (first[p] != (int)p){
+            continue;
+         }
+         Mat whole = wiener ? spectral.wienerFilter(in, psfs[p], snr)
+                            : spectral.inverseFilter(in, psfs[p], INVERSE_EPSILON);
+         forEachTile([&](int ty, int tx){
+            if (tileKernel(ty, tx) == (int)p){
+               blend(ty, tx, whole, Point(0, 0));
+            }
+         });
+      }
+   }else{
+      forEachTile([&](int ty, int tx){
+         // tile with halo, may reach over the image borders
+         int y0 = max(0, ty * step - step) - halo;
+         int x0 = max(0, tx * step - step) - halo;
+         int rows = min(in.rows, ty * step + step) + halo - y0;
+         int cols = min(in.cols, tx * step + step) + halo - x0;
+         if (rows <= 2 * halo || cols <= 2 * halo){
+            return;
+         }
+
+         vector<int> col(cols);
+         for(int x = 0; x < cols; x++){
+            col[x] = borderInterpolate(x0 + x, in.cols, borderType);
+         }
+         Mat region(rows, cols, CV_32FC1);
+         for(int y = 0; y < rows; y++){
+            int src = borderInterpolate(y0 + y, in.rows, borderType);
+            float* r = region.ptr<float>(y);
+            const float* s = (src < 0) ? 0 : in.ptr<float>(src);
+            for(int x = 0; x < cols; x++){
+               r[x] = (s && col[x] >= 0) ? s[col[x]] : 0.f;
+            }
+         }
+
+         Spectral spectral(BORDER_REFLECT);
+         Mat& psf = psfs[tileKernel(ty, tx)];
+         Mat tile = wiener ? spectral.wienerFilter(region, psf, snr)
+                           : spectral.inverseFilter(region, psf, INVERSE_EPSILON);
+         blend(ty, tx, tile, Point(x0, y0));
+      });
+   }
 
+   cutRange(restorated);
 
    return restorated;
 }
 
-/* *****************************
-  GIVEN FUNCTIONS
-***************************** */
-
-// function calls processing function
+// Gaussian kernel of the degradation
 /*
-in                   :  input image
-restorationType     :  integer defining which restoration function is used
-kernel               :  kernel used during restoration
-snr                  :  signal-to-noise ratio (only used by wieder filter)
-return               :  restorated image
+filterDev   :  standard deviation of kernel for gaussian blur
+return      :  the gaussian kernel
 */
-Mat Dip4::run(Mat& in, string restorationType, Mat& kernel, double snr){
+Mat Dip4::gaussianKernel(double filterDev){
 
-   if (restorationType.compare("wiener")==0){
-      return wienerFilter(in, kernel, snr);
-   }else{
-      return inverseFilter(in, kernel);
-   }
+    int kSize = round(filterDev*3)*2 - 1;
 
+    Mat gaussKernel = getGaussianKernel(kSize, filterDev, CV_32FC1);
+    return gaussKernel * gaussKernel.t();
 }
 
 // Function degrades a given image with gaussian blur and additive gaussian noise
@@ -321,14 +540,13 @@ img         :  input image
 degradedImg :  degraded output image
 filterDev   :  standard deviation of kernel for gaussian blur
 snr         :  signal to noise ratio for additive gaussian noise
+seed        :  seed of the noise, equal seeds give equal noise
 return      :  the used gaussian kernel
 */
-Mat Dip4::degradeImage(Mat& img, Mat& degradedImg, double filterDev, double snr){
+Mat Dip4::degradeImage(Mat& img, Mat& degradedImg, double filterDev, double snr, unsigned long long seed){
 
-    int kSize = round(filterDev*3)*2 - 1;
-   
-    Mat gaussKernel = getGaussianKernel(kSize, filterDev, CV_32FC1);
-    gaussKernel = gaussKernel * gaussKernel.t();
+    Mat gaussKernel = gaussianKernel(filterDev);
+    int kSize = gaussKernel.rows;
 
     Mat imgs = img.clone();
     dft( imgs, imgs, CV_DXT_FORWARD, img.rows);
@@ -342,11 +560,9 @@ Mat Dip4::degradeImage(Mat& img, Mat& degradedImg, double filterDev, double snr)
     Mat mean, stddev;
     meanStdDev(img, mean, stddev);
 
-    Mat noise = Mat::zeros(img.rows, img.cols, CV_32FC1);
-    randn(noise, 0, stddev.at<double>(0)/snr);
-    degradedImg = degradedImg + noise;
-    threshold(degradedImg, degradedImg, 255, 255, CV_THRESH_TRUNC);
-    threshold(degradedImg, degradedImg, 0, 0, CV_THRESH_TOZERO);
+    // additive noise from counter-based random numbers, cut to [0,255]
+    NoiseGenerator noise;
+    degradedImg = noise.gaussianNoise(degradedImg, stddev.at<double>(0)/snr, seed);
 
     return gaussKernel;
 }
@@ -363,8 +579,7 @@ void Dip4::showImage(const char* win, Mat img, bool cut){
 
    if (tmp.channels() == 1){
       if (cut){
-         threshold(tmp, tmp, 255, 255, CV_THRESH_TRUNC);
-         threshold(tmp, tmp, 0, 0, CV_THRESH_TOZERO);
+         cutRange(tmp);
       }else
          normalize(tmp, tmp, 0, 255, CV_MINMAX);
          
@@ -375,10 +590,31 @@ void Dip4::showImage(const char* win, Mat img, bool cut){
    imshow(win, tmp);
 }
 
+// textured test image, every row and column differs
+/*
+rows     :  number of rows
+cols     :  number of columns
+return   :  image with values (7*x*x + 13*y) mod 256
+*/
+Mat Dip4::patternImage(int rows, int cols){
+
+   Mat img(rows, cols, CV_32FC1);
+   for(int y=0; y<rows; y++){
+      for(int x=0; x<cols; x++){
+         img.at<float>(y,x) = (7*x*x + 13*y) % 256;
+      }
+   }
+   return img;
+}
+
 // function calls some basic testing routines to test individual functions for correctness
 void Dip4::test(void){
 
    test_circShift();
+   test_runBatch();
+   test_runSweep();
+   test_runTiled();
+   test_boundedQueue();
    cout << "Press enter to continue"  << endl;
    cin.get();
 
@@ -403,3 +639,176 @@ void Dip4::test_circShift(void){
    }
    cout << "Message: Dip4::circShift() seems to be correct" << endl;
 }
+
+void Dip4::test_runBatch(void){
+
+   Mat img = patternImage(64, 48);
+   Mat degraded, other;
+   Mat kernel = degradeImage(img, degraded, 2, 1000, 1);
+   degradeImage(img, other, 2, 100, 2);
+   Mat small = degraded(Rect(0, 0, 32, 40)).clone();
+
+   // every image of the batch has to be restored as by a single call, whatever its size
+   vector<Mat> batch;
+   batch.push_back(degraded);
+   batch.push_back(small);
+   batch.push_back(other);
+   const char* types[2] = {"inverse", "wiener"};
+   for(int t=0; t<2; t++){
+      vector<Mat> restored = runBatch(batch, types[t], kernel, 1000);
+      for(size_t i=0; i<batch.size(); i++){
+         Mat ref = run(batch[i], types[t], kernel, 1000);
+         if (restored[i].size() != ref.size() || norm(restored[i], ref, NORM_INF) > 0.01){
+            cout << "ERROR: Dip4::runBatch(): Result differs from single image restoration!" << endl;
+            return;
+         }
+      }
+   }
+   cout << "Message: Dip4::runBatch() seems to be correct" << endl;
+}
+
+void Dip4::test_runSweep(void){
+
+   Mat img = patternImage(64, 48);
+   Mat degraded;
+   Mat kernel = degradeImage(img, degraded, 2, 100, 1);
+
+   // every restoration of the sweep has to equal a single wiener filter call
+   vector<double> snrs;
+   snrs.push_back(1);
+   snrs.push_back(100);
+   snrs.push_back(10000);
+   vector<double> scores;
+   for(int parallel=0; parallel<2; parallel++){
+      vector<Mat> restored = runSweep(degraded, kernel, snrs, scores, img, parallel == 1);
+      if (restored.size() != snrs.size() || scores.size() != snrs.size()){
+         cout << "ERROR: Dip4::runSweep(): Wrong number of results!" << endl;
+         return;
+      }
+      for(size_t i=0; i<snrs.size(); i++){
+         Mat ref = run(degraded, "wiener", kernel, snrs[i]);
+         if (norm(restored[i], ref, NORM_INF) > 0.01){
+            cout << "ERROR: Dip4::runSweep(): Result differs from single wiener filter!" << endl;
+            return;
+         }
+      }
+   }
+   // the noise level of the degradation has to score best
+   if (scores[1] < scores[0] || scores[1] < scores[2]){
+      cout << "ERROR: Dip4::runSweep(): Scores do not favour the true signal to noise ratio!" << endl;
+      return;
+   }
+   cout << "Message: Dip4::runSweep() seems to be correct" << endl;
+}
+
+void Dip4::test_runTiled(void){
+
+   Mat img = patternImage(96, 128);
+   Mat degraded;
+   Mat kernel = degradeImage(img, degraded, 1.5, pow(10,5), 1);
+
+   // the same kernel everywhere: the tiles have to blend into the restoration of the whole image
+   // (default snr: the filter reaches over the whole image)
+   vector<Mat> psfs(6, kernel);
+   Mat output = runTiled(degraded, "wiener", psfs, 2, 3, pow(10,5), 32);
+   Mat ref = run(degraded, "wiener", kernel);
+   if (output.size() != img.size()){
+      cout << "ERROR: Dip4::runTiled(): Result has wrong size!" << endl;
+      return;
+   }
+   if (norm(output, ref, NORM_INF) > 0.01){
+      cout << "ERROR: Dip4::runTiled(): Result differs from the restoration of the whole image!" << endl;
+      return;
+   }
+
+   // low snr: tiles restored with a halo of the filter support, the borders included
+   degradeImage(img, degraded, 1.5, 30, 2);
+   const char* types[2] = {"inverse", "wiener"};
+   for(int t=0; t<2; t++){
+      output = runTiled(degraded, types[t], psfs, 2, 3, 30, 32);
+      ref = run(degraded, types[t], kernel, 30);
+      if (norm(output, ref, NORM_INF) > 0.5){
+         cout << "ERROR: Dip4::runTiled(): Tiles of the " << types[t] << " filter differ from the restoration of the whole image!" << endl;
+         return;
+      }
+   }
+
+   // left and right half with different kernels: far from the middle each half has to be
+   // restored as by its own kernel (tiles of 32 pixels, centers of the tiles up to 48 belong to the left)
+   Mat sharp = gaussianKernel(1);
+   vector<Mat> halves;
+   halves.push_back(sharp);
+   halves.push_back(kernel);
+   double snrs[2] = {pow(10,5), 30};
+   for(int i=0; i<2; i++){
+      output = runTiled(degraded, "wiener", halves, 1, 2, snrs[i], 32);
+      Mat left = run(degraded, "wiener", sharp, snrs[i]);
+      Mat right = run(degraded, "wiener", kernel, snrs[i]);
+      Rect l(0, 0, 48, img.rows), r(80, 0, 48, img.rows);
+      if (norm(output(l), left(l), NORM_INF) > 0.5 || norm(output(r), right(r), NORM_INF) > 0.5){
+         cout << "ERROR: Dip4::runTiled(): Regions are not restored with their own kernel!" << endl;
+         return;
+      }
+   }
+   cout << "Message: Dip4::runTiled() seems to be correct" << endl;
+}
+
+// checks order, capacity and the wake-up of threads waiting in push() and pop()
+void Dip4::test_boundedQueue(void){
+
+   BoundedQueue<int> queue(2);
+   int item = 0;
+   if (queue.tryPop(item) || !queue.tryPush(1) || !queue.push(2) || queue.tryPush(3)){
+      cout << "ERROR: BoundedQueue: Capacity is not kept!" << endl;
+      return;
+   }
+   if (!queue.pop(item) || item != 1){
+      cout << "ERROR: BoundedQueue: Items are not returned in order!" << endl;
+      return;
+   }
+
+   // a push into the full queue waits until an item is popped
+   queue.push(3);
+   atomic<bool> pushed(false);
+   thread producer([&](){ pushed = queue.push(4); });
+   this_thread::sleep_for(chrono::milliseconds(20));
+   bool waited = !pushed;
+   queue.pop(item);
+   producer.join();
+   if (!waited || !pushed){
+      cout << "ERROR: BoundedQueue: push() into a full queue does not wait!" << endl;
+      return;
+   }
+
+   // close() wakes a push waiting on the full queue, the remaining items can still be popped
+   atomic<bool> result(true);
+   producer = thread([&](){ result = queue.push(5); });
+   this_thread::sleep_for(chrono::milliseconds(20));
+   queue.close();
+   producer.join();
+   int a = 0, b = 0;
+   if (result || !queue.pop(a) || !queue.pop(b) || a != 3 || b != 4 || queue.pop(item)){
+      cout << "ERROR: BoundedQueue: close() does not wake up push() or items are lost!" << endl;
+      return;
+   }
+
+   // a pop on the empty queue waits for a push, close() wakes it up
+   BoundedQueue<int> empty(1);
+   atomic<int> popped(0);
+   thread consumer([&](){
+      int value;
+      while (empty.pop(value)){
+         popped = value;
+      }
+   });
+   this_thread::sleep_for(chrono::milliseconds(20));
+   empty.push(7);
+   this_thread::sleep_for(chrono::milliseconds(20));
+   empty.close();
+   consumer.join();
+   if (popped != 7 || empty.push(8)){
+      cout << "ERROR: BoundedQueue: pop() does not wake up on push() or close()!" << endl;
+      return;
+   }
+   cout << "Message: BoundedQueue seems to be correct" << endl;
+}
@@ -15,20 +15,43 @@ using namespace cv;
 
 class Dip4{
 
+   // the benchmark suite times the processing routines directly
+   friend class Benchmark;
+
    public:
       // constructor
-      Dip4(void){};
+      Dip4(void) : borderType(BORDER_WRAP){};
       // destructor
       ~Dip4(void){};
         
       // processing routines
       // start image restoration
       Mat run(Mat& in, string restorationType, Mat& kernel, double snr=pow(10,5));
+      // restoration of many images degraded by the same kernel, the filter is computed once per image size
+      vector<Mat> runBatch(vector<Mat>& in, string restorationType, Mat& kernel, double snr=pow(10,5));
+      // wiener restoration for several signal to noise ratios, the transforms of image and kernel are shared
+      // with a reference image, scores receives the PSNR (dB) of every restoration
+      vector<Mat> runSweep(Mat& in, Mat& kernel, const vector<double>& snrs, vector<double>& scores,
+                           Mat reference=Mat(), bool parallel=true);
+      // restoration of a video file or image sequence (printf pattern, e.g. frame_%04d.png) into target
+      // decoding, restoration (workers threads, 0 = automatic) and encoding run as pipelined stages
+      // connected by queues of queueSize frames; returns the frames per second (0 on failure)
+      double runStream(const string& source, const string& target, string restorationType, Mat& kernel,
+                       double snr=pow(10,5), int workers=0, int queueSize=4);
+      // restoration with a spatially varying kernel, psfs holds gridRows x gridCols kernels (row by row)
+      // of equally sized image regions; overlapping tiles of tileSize pixels are restored with the kernel
+      // of their region and blended. halo: pixels restored around each tile, < 0 = filter support
+      Mat runTiled(Mat& in, string restorationType, vector<Mat>& psfs, int gridRows, int gridCols,
+                   double snr=pow(10,5), int tileSize=256, int halo=-1);
       // testing routine
       void test(void);
       // function headers of given functions
-      Mat degradeImage(Mat& img, Mat& degradedImg, double filterDev, double snr);
+      Mat degradeImage(Mat& img, Mat& degradedImg, double filterDev, double snr, unsigned long long seed=0);
+      // gaussian kernel of the degradation for a given standard deviation
+      Mat gaussianKernel(double filterDev);
       void showImage(const char* win, Mat img, bool cut=true);
+      // border policy of the restoration (OpenCV border type, default BORDER_WRAP like the degradation)
+      void setBorderType(int type){ borderType = type; };
 
    private:
       // function headers of functions to be implemented
@@ -40,7 +63,18 @@ class Dip4{
       // --> re-use your (corrected) code
       Mat circShift(Mat& in, int dx, int dy);
       Mat frequencyConvolution(Mat& in, Mat& kernel);
+      // cuts values to [0,255]
+      static void cutRange(Mat& img);
     
       // testing routines
       void test_circShift(void);
+      void test_runBatch(void);
+      void test_runSweep(void);
+      void test_runTiled(void);
+      void test_boundedQueue(void);
+      // textured image for the tests
+      Mat patternImage(int rows, int cols);
+
+      // border policy of the restoration
+      int borderType;
 };
@@ -13,14 +13,28 @@
 using namespace std;
 
 // usage: path to image in argv[1], snr in argv[2], stddev of Gaussian blur in argv[3]
+// streaming mode: dip4 --stream source target snr stddev [wiener | inverse]
+//    restores every frame of a video file or image sequence (printf pattern, e.g. frame_%04d.png)
+//    blurred with the given stddev and writes the result into target, nothing waits for user input
 // main function. loads image, calls test and processing routines, records processing times
 int main(int argc, char** argv) {
 
+   // streaming mode
+   if (argc >= 6 && string(argv[1]) == "--stream"){
+      Dip4 dip4;
+      Mat kernel = dip4.gaussianKernel(atof(argv[5]));
+      string type = (argc >= 7) ? argv[6] : "wiener";
+      double fps = dip4.runStream(argv[2], argv[3], type, kernel, atof(argv[4]));
+      return (fps > 0) ? 0 : -1;
+   }
+
    // check if enough arguments are defined
    if (argc < 4){
       cout << "Usage:\n\tdip4 path_to_original snr stddev"  << endl;
       cout << "\t\t snr :\t\tsignal-to-noise ratio: the higher (e.g. 10,000), the less noise." << endl;
       cout << "\t\t stddev :\tstddev of Gaussian blur" << endl;
+      cout << "\tdip4 --stream source target snr stddev [wiener | inverse]" << endl;
+      cout << "\t\t source, target :\tvideo file or image sequence (e.g. frame_%04d.png)" << endl;
       cout << "Press enter to exit"  << endl;
       cin.get();
       return -1;